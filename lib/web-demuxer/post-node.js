@@ -0,0 +1,181 @@
+// Appended after post.js in the node build (make web-demuxer-node).
+// Files are read from the host file system by NODEFS instead of mounted by WORKERFS,
+// and packet streams are returned as ReadableStream instead of posted to the main thread.
+
+// ============ host file sources ============
+const HOST_ROOT = "/host";
+const hostFiles = new Map(); // path in HOST_ROOT -> HostFile
+let nodeFSRead = null;
+
+// rewrite NODEFS.stream_ops.read once to count the bytes read from each source
+function installHostReader() {
+  if (nodeFSRead) return;
+
+  if (!FS.analyzePath(HOST_ROOT).exists) {
+    FS.mkdir(HOST_ROOT);
+  }
+  FS.mount(FS.filesystems.NODEFS, { root: "/" }, HOST_ROOT);
+
+  nodeFSRead = FS.filesystems.NODEFS.stream_ops.read;
+  FS.filesystems.NODEFS.stream_ops.read = function read(stream, buffer, offset, length, position) {
+    const bytesRead = nodeFSRead(stream, buffer, offset, length, position);
+    const hostFile = hostFiles.get(stream.path);
+
+    if (hostFile) {
+      hostFile.bytesRead += bytesRead;
+      hostFile.readCount++;
+    }
+
+    return bytesRead;
+  }
+}
+
+/**
+ * A source session of a host file, same shape as WorkerFile for the session functions
+ */
+class HostFile {
+  /**
+   * @param path absolute path of a host file
+   */
+  constructor(path) {
+    installHostReader();
+
+    this.id = ++sessionIdCounter;
+    this.filePath = HOST_ROOT + path;
+    this.filePaths = [this.filePath];
+    this.mountOpts = {
+      files: [],
+    };
+    this.activeRequests = 0;
+    this.closing = false;
+    this.bytesRead = 0;
+    this.readCount = 0;
+    this.ioTrace = null;
+  }
+
+  mount() {
+    if (!FS.analyzePath(this.filePath).exists) {
+      throw new Error(`no such file: ${this.filePath.slice(HOST_ROOT.length)}`);
+    }
+    hostFiles.set(this.filePath, this);
+  }
+
+  unmount() {
+    hostFiles.delete(this.filePath);
+
+    for (const filePath of this.filePaths) {
+      Module.clear_seek_index(filePath);
+    }
+    dropCachedPackets(this);
+  }
+}
+
+/**
+ * Open a host file as a source session, closed by closeSource
+ * @param path absolute path of a host file
+ * @returns session id
+ */
+function openHostFile(path) {
+  const hostFile = new HostFile(path);
+
+  hostFile.mount();
+  sessions.set(hostFile.id, hostFile);
+
+  return hostFile.id;
+}
+
+// ============ packet streams ============
+/**
+ * A ReadableStream fed by a read function of web_demuxer.cpp, wasm suspends while the
+ * queue is at highWaterMark packets and stops when the stream is cancelled
+ */
+function createPacketStream(sessionId, read, highWaterMark = 1) {
+  let waiting = null;
+  let stopped = false;
+
+  const wake = () => {
+    if (waiting) {
+      waiting(stopped ? 0 : 1);
+      waiting = null;
+    }
+  };
+
+  return new ReadableStream({
+    start(controller) {
+      const caller = {
+        // 1 means continue, 0 means stop, -1 means wait for the consumer by waitAVPacketCredit
+        sendAVPacket(avPacket) {
+          if (avPacket === 0) {
+            if (!stopped) {
+              controller.close();
+            }
+            return 1;
+          }
+
+          if (stopped) {
+            avPacket.delete();
+            return 0;
+          }
+
+          controller.enqueue(avPacketToObject(avPacket));
+
+          return controller.desiredSize > 0 ? 1 : -1;
+        },
+        waitAVPacketCredit() {
+          return new Promise((resolve) => {
+            waiting = resolve;
+          });
+        },
+      };
+
+      let reading;
+
+      // started at once so the session counts it as active, packets are enqueued while it runs
+      try {
+        reading = withSource(sessionId, (filePath) => read(filePath, caller));
+      } catch (e) {
+        controller.error(e);
+        return;
+      }
+
+      Promise.resolve(reading)
+        .then((result) => {
+          if (result === 0 && !stopped) {
+            controller.error(new Error("read failed"));
+          }
+        }, (e) => {
+          if (!stopped) {
+            controller.error(e);
+          }
+        });
+    },
+    pull() {
+      wake();
+    },
+    cancel() {
+      stopped = true;
+      wake();
+    },
+  }, { highWaterMark });
+}
+
+function readAVPacketStream(sessionId, start = 0, end = 0, type = 0, streamIndex = -1, seekFlag = 1, highWaterMark) {
+  return createPacketStream(
+    sessionId,
+    (filePath, caller) => Module.read_av_packet(filePath, start, end, type, streamIndex, seekFlag, caller),
+    highWaterMark
+  );
+}
+
+function readKeyframePacketStream(sessionId, start = 0, end = 0, type = 0, streamIndex = -1, every = 1, minInterval = 0, highWaterMark) {
+  return createPacketStream(
+    sessionId,
+    (filePath, caller) => Module.read_keyframe_packet(filePath, start, end, type, streamIndex, every, minInterval, caller),
+    highWaterMark
+  );
+}
+
+// ============ Module Register ============
+Module.openHostFile = openHostFile;
+Module.readAVPacketStream = readAVPacketStream;
+Module.readKeyframePacketStream = readKeyframePacketStream;
@@ -1,39 +1,75 @@
 let logLevel = 32; // default as AV_LOG_INFO
+let memoryBudget = 0; // bytes, 0 for no budget
+
+const MAX_RETRY_DELAY = 8000;
+// without shared memory the wait spins a core, so the backoff is capped and failures surface sooner
+const MAX_SPIN_DELAY = 100;
+const MAX_REQUEST_TIMINGS = 1024;
+// Atomics.wait blocks the worker without spinning, shared memory needs cross-origin isolation
+const sleepSignal = typeof SharedArrayBuffer !== 'undefined' ? new Int32Array(new SharedArrayBuffer(4)) : null;
 
 function sleep(duration) {
+  if (sleepSignal) {
+    Atomics.wait(sleepSignal, 0, 0, duration);
+    return;
+  }
+
   const start = Date.now();
+  const spinDuration = Math.min(duration, MAX_SPIN_DELAY);
 
-  while (Date.now() - start < duration) {
+  while (Date.now() - start < spinDuration) {
     // sync wait
   }
 }
 
-function retry(fn, retries = 3, delay = 500) {
+class RequestError extends Error {
+  constructor(message, status = 0, retryable = true) {
+    super(message);
+    this.status = status;
+    this.retryable = retryable;
+  }
+}
+
+function isRetryableStatus(status) {
+  return status === 0 || status === 408 || status === 429 || status >= 500;
+}
+
+/**
+ * retry with exponential backoff and jitter, errors that can't succeed on retry fail at once
+ */
+function retry(fn, retries = 3, delay = 200) {
   let attempt = 0;
 
-  while (attempt < retries) {
+  while (true) {
     try {
-      return fn();
+      return fn(attempt);
     } catch (error) {
       if (logLevel >= 24) {
         console.warn(`Attempt ${attempt + 1} failed: ${error.message}`);
       }
-      attempt++;
-      if (attempt >= retries) {
-        throw new Error(`Failed after ${retries} attempts`);
+      if (attempt >= retries || error.retryable === false) {
+        throw new Error(`Failed after ${attempt + 1} attempts: ${error.message}`);
       }
-      sleep(delay)
+      attempt++;
+
+      const maxDelay = Math.min(delay * 2 ** (attempt - 1), MAX_RETRY_DELAY);
+
+      sleep(maxDelay / 2 + Math.random() * maxDelay / 2);
     }
   }
 }
 
-function getFileSize(url) {
+function getFileSize(url, timing) {
   const xhr = new XMLHttpRequest();
   xhr.open('HEAD', url, false);
   xhr.send();
 
+  if (timing) {
+    timing.status = xhr.status;
+  }
+
   if (xhr.status !== 200) {
-    throw new Error(`getFileSize request failed: ${url}`);
+    throw new RequestError(`getFileSize request failed: ${url}`, xhr.status, isRetryableStatus(xhr.status));
   }
 
   const size = parseInt(xhr.getResponseHeader('Content-Length'));
@@ -41,7 +77,10 @@ function getFileSize(url) {
   return size;
 }
 
-function fetchArrayBuffer(url, position, length) {
+/**
+ * @param expected bytes the range must return, a shorter or longer body is retried
+ */
+function fetchArrayBuffer(url, position, length, expected = length, timing) {
   const xhr = new XMLHttpRequest();
 
   xhr.open('GET', url, false);
@@ -49,60 +88,480 @@ function fetchArrayBuffer(url, position, length) {
   xhr.responseType = 'arraybuffer';
   xhr.send();
 
+  if (timing) {
+    timing.status = xhr.status;
+  }
+
   if (xhr.status !== 206 && xhr.status !== 200) {
-    throw new Error(`fetchArrayBuffer request failed: ${url}`);
+    throw new RequestError(`fetchArrayBuffer request failed: ${url}, status ${xhr.status}`, xhr.status, isRetryableStatus(xhr.status));
   }
 
-  return xhr.response;
+  // the whole file is returned when the server ignores the range
+  const response = xhr.status === 200
+    ? xhr.response.slice(position, position + expected)
+    : xhr.response;
+
+  if (response.byteLength !== expected) {
+    throw new RequestError(`fetchArrayBuffer got ${response.byteLength} of ${expected} bytes: ${url}`, xhr.status);
+  }
+
+  return response;
 }
 
-class WorkerFile {
-  constructor(source) {
-    let file
+/**
+ * Blocking requests per read, when parallel range requests need shared memory that is not
+ * available, same interface as RangeLoader
+ */
+class XHRLoader {
+  constructor(url, options = {}) {
+    this.url = url;
+    this.retries = options.retries ?? 3;
+    this.retryDelay = options.retryDelay ?? 200;
+    this.maxPrefetchSize = options.tailPrefetchSize ?? 16 * 1024 * 1024;
+    this.size = -1;
+    this.requestTimings = [];
+    this.prefetched = null; // { start, bytes }
+  }
+
+  /**
+   * run a blocking request with retries, and record its timing
+   */
+  request(start, length, fn) {
+    const requestStart = performance.now();
+    const timing = {
+      start,
+      length,
+      startTime: performance.timeOrigin + requestStart,
+      ttfb: 0,
+      duration: 0,
+      attempts: 0,
+      hedged: false,
+      status: 0,
+    };
 
-    if (typeof source === 'string') {
-      file = new File([], encodeURIComponent(source)); // create a placeholder file
+    try {
+      return retry((attempt) => {
+        const attemptStart = performance.now();
 
-      // rewrite WORKERFS.stream_ops.read to support read from url
-      // https://github.com/emscripten-core/emscripten/blob/main/src/library_workerfs.js#L127-L133
-      FS.filesystems.WORKERFS.stream_ops.read = function read(stream, buffer, offset, length, position) {
-        const url = decodeURIComponent(stream.node.contents.name);
+        timing.attempts = attempt + 1;
+        timing.status = 0;
 
-        if (stream.node.size === 0) {
-          stream.node.size = retry(() => getFileSize(url)) // rewrite the size
+        try {
+          return fn(timing);
+        } finally {
+          // a blocking request has no separate header time
+          timing.ttfb = performance.now() - attemptStart;
         }
+      }, this.retries, this.retryDelay);
+    } finally {
+      timing.duration = performance.now() - requestStart;
+      this.requestTimings.push(timing);
+
+      if (this.requestTimings.length > MAX_REQUEST_TIMINGS) {
+        this.requestTimings.shift();
+      }
+    }
+  }
+
+  getSize() {
+    if (this.size < 0) {
+      this.size = this.request(0, 0, (timing) => getFileSize(this.url, timing));
+    }
+
+    return this.size;
+  }
 
-        if (position >= stream.node.size) return 0;
+  read(buffer, offset, length, position) {
+    const size = this.getSize();
 
-        const ab = retry(() => fetchArrayBuffer(url, position, length));
-        const byteLength = ab.byteLength;
+    if (position >= size) return 0;
 
-        buffer.set(new Uint8Array(ab), offset);
+    const expected = Math.min(length, size - position);
+    const { prefetched } = this;
+
+    if (prefetched && position >= prefetched.start && position + expected <= prefetched.start + prefetched.bytes.byteLength) {
+      const from = position - prefetched.start;
+
+      buffer.set(prefetched.bytes.subarray(from, from + expected), offset);
+
+      return expected;
+    }
+
+    const ab = this.request(position, length, (timing) => fetchArrayBuffer(this.url, position, length, expected, timing));
+
+    buffer.set(new Uint8Array(ab), offset);
+
+    return ab.byteLength;
+  }
+
+  /**
+   * fetch a range in one request, up to tailPrefetchSize bytes, reads inside it are served from it
+   */
+  prefetch(start, length) {
+    length = Math.min(length, this.maxPrefetchSize);
+
+    if (this.prefetched || length <= 0) return;
+
+    try {
+      const ab = this.request(start, length, (timing) => fetchArrayBuffer(this.url, start, length, length, timing));
+
+      this.prefetched = { start, bytes: new Uint8Array(ab) };
+    } catch (e) {
+      // reads fall back to their own requests
+    }
+  }
+
+  getRequestTimings() {
+    return this.requestTimings.slice();
+  }
+
+  close() {
+    this.prefetched = null;
+  }
+}
+
+/**
+ * The offset of the top-level atom after mdat, when a MP4 stores moov after mdat
+ * (not faststart), -1 otherwise
+ * @param head the first bytes of the file
+ */
+function findTrailingMoov(head, size) {
+  const view = new DataView(head.buffer, head.byteOffset, head.byteLength);
+  let position = 0;
+
+  while (position + 8 <= head.byteLength) {
+    const type = String.fromCharCode(...head.subarray(position + 4, position + 8));
+    let atomSize = view.getUint32(position);
+
+    if ((position === 0 && type !== 'ftyp') || type === 'moov') return -1;
+
+    if (atomSize === 1) {
+      if (position + 16 > head.byteLength) return -1;
+      atomSize = Number(view.getBigUint64(position + 8));
+    }
+
+    // size 0 extends to the end of the file
+    if (atomSize < 8) return -1;
+
+    const next = position + atomSize;
+
+    if (next >= size) return -1;
+
+    if (next > head.byteLength) {
+      return type === 'mdat' ? next : -1;
+    }
+
+    position = next;
+  }
 
-        return byteLength;
+  return -1;
+}
+
+const MOUNT_ROOT = "/data";
+const urlSources = new WeakMap(); // placeholder file -> url
+const sessions = new Map(); // session id -> WorkerFile
+let sessionIdCounter = 0;
+let workerFSRead = null;
+
+const mountedFiles = new WeakMap(); // file node -> WorkerFile
+const rangeLoaders = new WeakMap(); // placeholder file -> RangeLoader
+const probedLoaders = new WeakSet(); // loaders whose file layout has been checked
+
+// rewrite WORKERFS.stream_ops.read once to count the bytes read from each source,
+// and support read from url, other files keep the original read
+// https://github.com/emscripten-core/emscripten/blob/main/src/library_workerfs.js#L127-L133
+function installSourceReader() {
+  if (workerFSRead) return;
+
+  workerFSRead = FS.filesystems.WORKERFS.stream_ops.read;
+  FS.filesystems.WORKERFS.stream_ops.read = function read(stream, buffer, offset, length, position) {
+    const workerFile = mountedFiles.get(stream.node);
+    const startTime = workerFile && workerFile.ioTrace ? performance.now() : 0;
+    const bytesRead = readSource(stream, buffer, offset, length, position);
+
+    if (workerFile) {
+      workerFile.bytesRead += bytesRead;
+      workerFile.readCount++;
+
+      if (workerFile.ioTrace) {
+        workerFile.ioTrace.push(`${position},${length},${(performance.now() - startTime).toFixed(3)}`);
       }
+    }
+
+    return bytesRead;
+  }
+}
+
+// parallel range requests when the worker provides Module.createRangeLoader, otherwise blocking requests
+function getRangeLoader(file, url) {
+  let loader = rangeLoaders.get(file);
+
+  if (!loader) {
+    loader = Module.createRangeLoader
+      ? Module.createRangeLoader(url)
+      : new XHRLoader(url, Module.urlSourceOptions);
+    rangeLoaders.set(file, loader);
+  }
+
+  return loader;
+}
+
+function readSource(stream, buffer, offset, length, position) {
+  const url = urlSources.get(stream.node.contents);
+
+  if (!url) {
+    return workerFSRead(stream, buffer, offset, length, position);
+  }
+
+  const loader = getRangeLoader(stream.node.contents, url);
+
+  stream.node.size = loader.getSize(); // rewrite the size
+
+  const bytesRead = loader.read(buffer, offset, length, position);
+
+  // a MP4 with moov at the end is opened by walking the top-level atoms with small reads,
+  // fetch everything after mdat at once instead
+  if (position === 0 && !probedLoaders.has(loader)) {
+    const head = new Uint8Array(buffer.buffer, buffer.byteOffset + offset, bytesRead);
+    const moovOffset = findTrailingMoov(head, stream.node.size);
+
+    probedLoaders.add(loader);
+
+    if (moovOffset > 0) {
+      loader.prefetch(moovOffset, stream.node.size - moovOffset);
+    }
+  }
+
+  return bytesRead;
+}
+
+function toMountFile(source) {
+  if (typeof source === 'string') {
+    const file = new File([], encodeURIComponent(source)); // create a placeholder file
+
+    urlSources.set(file, source);
+
+    return file;
+  }
+
+  return source;
+}
+
+class WorkerFile {
+  /**
+   * @param source a File / url, or a list of them mounted at once
+   * @param id session id to reuse, a new one by default
+   */
+  constructor(source, id) {
+    let files;
+
+    if (Array.isArray(source)) {
+      // prefix names to keep them unique in one mount point, keeping the extension for probing
+      files = source.map((item, index) => {
+        const file = toMountFile(item);
+        const renamed = new File([file], `${index}-${file.name}`);
+
+        if (urlSources.has(file)) {
+          urlSources.set(renamed, urlSources.get(file));
+        }
+
+        return renamed;
+      });
     } else {
-      file = source;
+      files = [toMountFile(source)];
     }
 
-    this.mountPoint = "/data";
+    installSourceReader();
+
+    // every file gets its own mount point, so several sources can be mounted at once
+    this.id = id ?? ++sessionIdCounter;
+    sessionIdCounter = Math.max(sessionIdCounter, this.id);
+    this.source = source;
+    this.mountPoint = MOUNT_ROOT + "/" + this.id;
     this.mountOpts = {
-      files: [file],
+      files,
     };
-    this.filePath = this.mountPoint + "/" + file.name;
+    this.filePaths = files.map((file) => this.mountPoint + "/" + file.name);
+    this.filePath = this.filePaths[0];
+    this.activeRequests = 0;
+    this.closing = false;
+    this.bytesRead = 0;
+    this.readCount = 0;
+    this.ioTrace = null; // recorded reads, one "offset,length,latency" line each
+    this.packetCacheHits = 0;
+    this.packetCacheMisses = 0;
   }
 
   mount() {
+    if (!FS.analyzePath(MOUNT_ROOT).exists) {
+      FS.mkdir(MOUNT_ROOT);
+    }
     FS.mkdir(this.mountPoint);
     FS.mount(FS.filesystems.WORKERFS, this.mountOpts, this.mountPoint);
+
+    for (const filePath of this.filePaths) {
+      mountedFiles.set(FS.lookupPath(filePath).node, this);
+    }
   }
 
   unmount() {
+    for (const file of this.mountOpts.files) {
+      const loader = rangeLoaders.get(file);
+
+      if (loader) {
+        loader.close();
+        rangeLoaders.delete(file);
+      }
+    }
+
+    for (const filePath of this.filePaths) {
+      Module.clear_seek_index(filePath);
+    }
+    dropCachedPackets(this);
+
     FS.unmount(this.mountPoint);
     FS.rmdir(this.mountPoint);
   }
 }
 
+// ============ source sessions ============
+/**
+ * @param sessionId reopen the source of a recycled module under its previous session id
+ */
+function openSource(source, sessionId) {
+  const workerFile = new WorkerFile(source, sessionId);
+
+  workerFile.mount();
+  sessions.set(workerFile.id, workerFile);
+
+  return workerFile.id;
+}
+
+function closeSource(sessionId) {
+  const workerFile = sessions.get(sessionId);
+
+  if (!workerFile) return;
+
+  sessions.delete(sessionId);
+
+  // unmount once the requests still running on this source finish
+  if (workerFile.activeRequests > 0) {
+    workerFile.closing = true;
+  } else {
+    workerFile.unmount();
+  }
+}
+
+// session id -> source of every open session, to reopen them in a new module instance
+function getOpenSources() {
+  return Array.from(sessions, ([sessionId, workerFile]) => [sessionId, workerFile.source]);
+}
+
+// bytes read from the source of a session so far, the number of reads and the worker heap size
+function getIOStats(sessionId) {
+  const workerFile = sessions.get(sessionId);
+
+  if (!workerFile) {
+    throw new Error(`source session ${sessionId} is not open`);
+  }
+
+  const loader = rangeLoaders.get(workerFile.mountOpts.files[0]);
+
+  return {
+    bytesRead: workerFile.bytesRead,
+    readCount: workerFile.readCount,
+    // the wasm memory of the worker only grows until its module instance is recycled
+    heapSize: HEAPU8.length,
+    packetCache: {
+      hits: workerFile.packetCacheHits,
+      misses: workerFile.packetCacheMisses,
+      hitRate: workerFile.packetCacheHits / (workerFile.packetCacheHits + workerFile.packetCacheMisses || 1),
+      size: getCachedPacketSize(workerFile),
+    },
+    ...(loader ? { requests: loader.getRequestTimings() } : {}),
+  };
+}
+
+/**
+ * I/O trace: every read of a session from FFmpeg, as "offset,length,latency_ms" lines
+ * after a "# web-demuxer io trace v1 size=<file size>" header
+ */
+function startIOTrace(sessionId) {
+  const workerFile = sessions.get(sessionId);
+
+  if (!workerFile) {
+    throw new Error(`source session ${sessionId} is not open`);
+  }
+
+  workerFile.ioTrace = [];
+}
+
+function stopIOTrace(sessionId) {
+  const workerFile = sessions.get(sessionId);
+
+  if (!workerFile || !workerFile.ioTrace) {
+    throw new Error(`io trace of source session ${sessionId} is not started`);
+  }
+
+  const size = FS.lookupPath(workerFile.filePath).node.size;
+  const trace = [`# web-demuxer io trace v1 size=${size}`, ...workerFile.ioTrace].join("\n") + "\n";
+
+  workerFile.ioTrace = null;
+
+  return trace;
+}
+
+/**
+ * run fn with the mounted file path of a source,
+ * source is either an opened session id or a File / url for a one-off mount
+ */
+function withSource(source, fn) {
+  if (typeof source === 'number') {
+    const workerFile = sessions.get(source);
+
+    if (!workerFile) {
+      throw new Error(`source session ${source} is not open`);
+    }
+
+    return runOnWorkerFile(workerFile, fn);
+  }
+
+  const workerFile = new WorkerFile(source);
+
+  workerFile.mount();
+  workerFile.closing = true;
+
+  return runOnWorkerFile(workerFile, fn);
+}
+
+function runOnWorkerFile(workerFile, fn) {
+  const done = () => {
+    workerFile.activeRequests--;
+
+    if (workerFile.closing && workerFile.activeRequests === 0) {
+      workerFile.unmount();
+    }
+  };
+  let result;
+
+  workerFile.activeRequests++;
+
+  try {
+    result = fn(workerFile.filePath);
+  } catch(e) {
+    done();
+    throw e;
+  }
+
+  if (result instanceof Promise) {
+    return result.finally(done);
+  }
+
+  done();
+
+  return result;
+}
+
 function avStreamToObject(avStream) {
   const extradata = new Uint8Array(avStream.extradata);
   const result = {
@@ -147,6 +606,7 @@ function avPacketToObject(avPacket) {
   const data = new Uint8Array(avPacket.data);
 
   const result = {
+    stream_index: avPacket.stream_index,
     keyframe: avPacket.keyframe,
     timestamp: avPacket.timestamp,
     duration: avPacket.duration,
@@ -160,28 +620,18 @@ function avPacketToObject(avPacket) {
 }
 
 function getAVStream(source, type = 0, streamIndex = -1) {
-  const workerFile = new WorkerFile(source);
-
-  workerFile.mount();
-
   try {
-    const avStream = Module.get_av_stream(workerFile.filePath, type, streamIndex);
+    const avStream = withSource(source, (filePath) => Module.get_av_stream(filePath, type, streamIndex));
 
     return avStreamToObject(avStream);
   } catch(e) {
     throw new Error("get_av_stream failed: " + e.message);
-  } finally {
-    workerFile.unmount()
   }
 }
 
 function getAVStreams(source) {
-  const workerFile = new WorkerFile(source);
-
-  workerFile.mount();
-
   try {
-    const avStreamList = Module.get_av_streams(workerFile.filePath);
+    const avStreamList = withSource(source, (filePath) => Module.get_av_streams(filePath));
     const result = [] 
 
     for (let i = 0; i < avStreamList.streams.size(); i++) {
@@ -193,64 +643,141 @@ function getAVStreams(source) {
     return result;
   } catch(e) {
     throw new Error("get_av_streams failed: " + e.message);
-  } finally {
-    workerFile.unmount();
   }
 }
 
-function getMediaInfo(source) {
-  const workerFile = new WorkerFile(source);
-
-  workerFile.mount();
+function mediaInfoToObject(mediaInfo) {
+  const result = {
+    format_name: mediaInfo.format_name,
+    duration: mediaInfo.duration,
+    bit_rate: mediaInfo.bit_rate,
+    start_time: mediaInfo.start_time,
+    nb_streams: mediaInfo.nb_streams,
+    streams: []
+  };
 
-  try {
-    const mediaInfo = Module.get_media_info(workerFile.filePath);
-    const result = {
-      format_name: mediaInfo.format_name,
-      duration: mediaInfo.duration,
-      bit_rate: mediaInfo.bit_rate,
-      start_time: mediaInfo.start_time,
-      nb_streams: mediaInfo.nb_streams,
-      streams: []
-    };
+  for (let i = 0; i < mediaInfo.streams.size(); i++) {
+    result.streams.push(avStreamToObject(mediaInfo.streams.get(i)));
+  }
 
-    for (let i = 0; i < mediaInfo.streams.size(); i++) {
-      result.streams.push(avStreamToObject(mediaInfo.streams.get(i)));
-    }
+  mediaInfo.streams.delete();
 
-    mediaInfo.streams.delete();
+  return result;
+}
 
-    return result;
+function getMediaInfo(source) {
+  try {
+    return mediaInfoToObject(withSource(source, (filePath) => Module.get_media_info(filePath)));
   } catch(e) {
     throw new Error("get_media_info failed: " + e.message);
-  } finally {
-    workerFile.unmount();
   }
 }
 
-function getAVPacket(source, time, type = 0, streamIndex = -1, seekFlag = 1) {
-  const workerFile = new WorkerFile(source);
+/**
+ * Probe a batch of sources mounted at once, each result is posted as soon as it is ready
+ * @returns number of probed sources
+ */
+function probeMany(messageId, sources) {
+  const workerFile = new WorkerFile(sources);
 
   workerFile.mount();
+  workerFile.closing = true;
+
+  return runOnWorkerFile(workerFile, () => {
+    workerFile.filePaths.forEach((filePath, index) => {
+      const startTime = performance.now();
+      const postData = {
+        type: "ProbeResult",
+        msgId: messageId,
+        result: { index },
+      };
+
+      try {
+        const mediaInfo = mediaInfoToObject(Module.get_media_info(filePath));
+
+        postData.result.mediaInfo = mediaInfo;
+        postData.result.probeTime = performance.now() - startTime;
+        self.postMessage(postData, mediaInfo.streams.map((stream) => stream.extradata.buffer));
+      } catch(e) {
+        postData.result.error = "get_media_info failed: " + e.message;
+        postData.result.probeTime = performance.now() - startTime;
+        self.postMessage(postData);
+      }
+    });
+
+    return sources.length;
+  });
+}
+
+function getAVPacket(source, time, type = 0, streamIndex = -1, seekFlag = 1, requestId = -1) {
+  // only backward seeks of open sessions resolve to a known keyframe
+  const workerFile = seekFlag === AVSEEK_FLAG_BACKWARD ? sessions.get(source) : undefined;
+
+  if (workerFile) {
+    const packet = findCachedPacket(workerFile, type, streamIndex, time);
+
+    if (packet) {
+      workerFile.packetCacheHits++;
+
+      return packet;
+    }
+
+    workerFile.packetCacheMisses++;
+  }
 
   try {
-    const avPacket = Module.get_av_packet(workerFile.filePath, time, type, streamIndex, seekFlag);
+    const avPacket = withSource(source, (filePath) => Module.get_av_packet(filePath, time, type, streamIndex, seekFlag, requestId));
+    const result = avPacketToObject(avPacket);
+
+    if (workerFile && result.keyframe) {
+      cachePacket(workerFile, type, streamIndex, time, result);
+    }
 
-    return avPacketToObject(avPacket);
+    return result;
   } catch(e) {
     throw new Error("get_av_packet failed: " + e.message);
-  } finally {
-    workerFile.unmount()
   }
 }
 
 function getAVPackets(source, time, seekFlag = 1) {
-  const workerFile = new WorkerFile(source);
+  try {
+    const avPacketList = withSource(source, (filePath) => Module.get_av_packets(filePath, time, seekFlag));
+    const result = [];
 
-  workerFile.mount();
+    for (let i = 0; i < avPacketList.packets.size(); i++) {
+      result.push(avPacketToObject(avPacketList.packets.get(i)));
+    }
+
+    avPacketList.packets.delete();
 
+    return result;
+  } catch(e) {
+    throw new Error("get_av_packets failed: " + e.message);
+  }
+}
+
+function getSampleTable(source, type = 0, streamIndex = -1) {
+  try {
+    const sampleTable = withSource(source, (filePath) => Module.get_sample_table(filePath, type, streamIndex));
+    const result = {
+      stream_index: sampleTable.stream_index,
+      timestamps: new Float64Array(sampleTable.timestamps),
+      offsets: new Float64Array(sampleTable.offsets),
+      sizes: new Int32Array(sampleTable.sizes),
+      keyframes: new Uint8Array(sampleTable.keyframes),
+    };
+
+    sampleTable.delete();
+
+    return result;
+  } catch(e) {
+    throw new Error("get_sample_table failed: " + e.message);
+  }
+}
+
+function getSamples(source, streamIndex, first, count = 1) {
   try {
-    const avPacketList = Module.get_av_packets(workerFile.filePath, time, seekFlag);
+    const avPacketList = withSource(source, (filePath) => Module.get_samples(filePath, streamIndex, first, count));
     const result = [];
 
     for (let i = 0; i < avPacketList.packets.size(); i++) {
@@ -261,9 +788,36 @@ function getAVPackets(source, time, seekFlag = 1) {
 
     return result;
   } catch(e) {
-    throw new Error("get_av_packets failed: " + e.message);
-  } finally {
-    workerFile.unmount()
+    throw new Error("get_samples failed: " + e.message);
+  }
+}
+
+function vectorToArray(vector) {
+  const result = [];
+
+  for (let i = 0; i < vector.size(); i++) {
+    result.push(vector.get(i));
+  }
+
+  vector.delete();
+
+  return result;
+}
+
+async function analyzeStream(source, start = 0, end = 0, type = 0, streamIndex = -1, bitrateBucket = 1) {
+  const slicer = createSourceSlicer(source);
+
+  try {
+    const analysis = await withSource(source, (filePath) => Module.analyze_stream(filePath, start, end, type, streamIndex, bitrateBucket, slicer));
+
+    return {
+      ...analysis,
+      gop_histogram: vectorToArray(analysis.gop_histogram),
+      bitrate_series: vectorToArray(analysis.bitrate_series),
+      discontinuities: vectorToArray(analysis.discontinuities),
+    };
+  } catch(e) {
+    throw new Error("analyze_stream failed: " + e.message);
   }
 }
 
@@ -274,78 +828,771 @@ async function readAVPacket(
   end = 0,
   type = 0,
   streamIndex = -1,
-  seekFlag = 1
+  seekFlag = 1,
+  readAhead,
+  packetRing
 ) {
-  const workerFile = new WorkerFile(source);
+  const sender = createPacketSender(msgId, readAhead, packetRing);
 
-  workerFile.mount();
+  try {
+    const result = await withSource(source, (filePath) => Module.read_av_packet(filePath, start, end, type, streamIndex, seekFlag, {
+      sendAVPacket: sender.sendAVPacket,
+      waitAVPacketCredit: sender.waitAVPacketCredit,
+    }));
+
+    if (result === 0) {
+      throw new Error("return 0");
+    }
+  } catch(e) {
+    throw new Error("read_av_packet failed: " + e.message);
+  } finally {
+    sender.close();
+  }
+}
+
+/**
+ * The streams and the first keyframe at start are posted as a PlaybackStart message
+ * from the same open, the packets that follow as a packet stream
+ */
+async function startPlayback(
+  msgId,
+  source,
+  start = 0,
+  end = 0,
+  videoStreamIndex = -1,
+  audioStreamIndex = -1,
+  readAhead,
+  packetRing
+) {
+  const sender = createPacketSender(msgId, readAhead, packetRing);
+
+  const sendPlaybackStart = (avStreamList, avPacket) => {
+    const streams = [];
+
+    for (let i = 0; i < avStreamList.streams.size(); i++) {
+      streams.push(avStreamToObject(avStreamList.streams.get(i)));
+    }
+    avStreamList.streams.delete();
+
+    const packet = avPacketToObject(avPacket);
+
+    self.postMessage({
+      type: "PlaybackStart",
+      msgId,
+      result: { streams, packet },
+    }, [packet.data.buffer]);
+  };
+
+  try {
+    const result = await withSource(source, (filePath) => Module.start_playback(filePath, start, end, videoStreamIndex, audioStreamIndex, {
+      sendPlaybackStart,
+      sendAVPacket: sender.sendAVPacket,
+      waitAVPacketCredit: sender.waitAVPacketCredit,
+    }));
+
+    if (result === 0) {
+      throw new Error("return 0");
+    }
+  } catch(e) {
+    throw new Error("start_playback failed: " + e.message);
+  } finally {
+    sender.close();
+  }
+}
+
+async function readKeyframePacket(
+  msgId,
+  source,
+  start = 0,
+  end = 0,
+  type = 0,
+  streamIndex = -1,
+  every = 1,
+  minInterval = 0,
+  readAhead,
+  packetRing
+) {
+  const sender = createPacketSender(msgId, readAhead, packetRing);
+
+  try {
+    const result = await withSource(source, (filePath) => Module.read_keyframe_packet(filePath, start, end, type, streamIndex, every, minInterval, {
+      sendAVPacket: sender.sendAVPacket,
+      waitAVPacketCredit: sender.waitAVPacketCredit,
+    }));
+
+    if (result === 0) {
+      throw new Error("return 0");
+    }
+  } catch(e) {
+    throw new Error("read_keyframe_packet failed: " + e.message);
+  } finally {
+    sender.close();
+  }
+}
+
+/**
+ * Walk the GOPs of a stream backwards, each GOP is posted as a GOPStream message of its
+ * packets in decode order, null ends the stream
+ */
+async function readReverseGOP(msgId, source, start = 0, end = 0, type = 0, streamIndex = -1, highWaterMark) {
+  const sender = createGOPSender(msgId, highWaterMark);
 
   try {
-    const result = await Module.read_av_packet(workerFile.filePath, start, end, type, streamIndex, seekFlag, {
-      sendAVPacket: genSendAVPacket(msgId),
+    const result = await withSource(source, (filePath) => Module.read_reverse_gop(filePath, start, end, type, streamIndex, {
+      sendGOP: sender.sendGOP,
+      waitGOPCredit: sender.waitGOPCredit,
+    }));
+
+    if (result === 0) {
+      throw new Error("return 0");
+    }
+  } catch(e) {
+    throw new Error("read_reverse_gop failed: " + e.message);
+  } finally {
+    sender.close();
+  }
+}
+
+/**
+ * Stream copy a clip of the source into a new container, output chunks are posted as
+ * ExportChunk messages, null ends the stream
+ */
+async function exportClip(msgId, source, format, start = 0, end = 0, streamIndices = [], highWaterMark) {
+  const sender = createChunkSender(msgId, highWaterMark);
+
+  try {
+    const result = await withSource(source, (filePath) => Module.export_clip(filePath, format, start, end, streamIndices, {
+      writeChunk: sender.writeChunk,
+      waitChunkCredit: sender.waitChunkCredit,
+    }));
+
+    if (result === 0) {
+      throw new Error("return 0");
+    }
+  } catch(e) {
+    throw new Error("export_clip failed: " + e.message);
+  } finally {
+    sender.close();
+  }
+}
+
+/**
+ * Record the seek points of a source without an index of its own by reading it once,
+ * in slices between other requests. Resolves to the number of seek points.
+ */
+async function buildSeekIndex(source) {
+  const slicer = createSourceSlicer(source);
+
+  try {
+    const result = await withSource(source, (filePath) => Module.build_seek_index(filePath, slicer));
+
+    if (result < 0) {
+      throw new Error("return -1");
+    }
+
+    return result;
+  } catch(e) {
+    throw new Error("build_seek_index failed: " + e.message);
+  }
+}
+
+// ============ packet cache ============
+const AVSEEK_FLAG_BACKWARD = 1;
+const PACKET_CACHE_SIZE = 16 * 1024 * 1024;
+// keyframes returned by getAVPacket, least recently used first
+const packetCache = new Set();
+let packetCacheBytes = 0;
+
+// bytes the cache may hold, the share of the memory budget a buffer may take (MEMORY_BUDGET_SHARE set by the worker)
+function getPacketCacheLimit() {
+  return memoryBudget > 0 ? Math.min(PACKET_CACHE_SIZE, Math.floor(memoryBudget * Module.memoryBudgetShare)) : PACKET_CACHE_SIZE;
+}
+
+/**
+ * A backward seek to a time in [start, end] of an entry resolves to its keyframe:
+ * the requests that returned it show there is no other keyframe in between.
+ * Packets are copied in and out, the posted one is transferred to the main thread.
+ */
+function findCachedPacket(workerFile, type, streamIndex, time) {
+  for (const entry of packetCache) {
+    if (entry.workerFile === workerFile && entry.type === type && entry.streamIndex === streamIndex &&
+        entry.start <= time && time <= entry.end) {
+      packetCache.delete(entry);
+      packetCache.add(entry);
+
+      return { ...entry.packet, data: entry.packet.data.slice() };
+    }
+  }
+
+  return null;
+}
+
+function cachePacket(workerFile, type, streamIndex, time, packet) {
+  for (const entry of packetCache) {
+    if (entry.workerFile === workerFile && entry.type === type && entry.streamIndex === streamIndex &&
+        entry.packet.timestamp === packet.timestamp) {
+      entry.start = Math.min(entry.start, time);
+      entry.end = Math.max(entry.end, time);
+      packetCache.delete(entry);
+      packetCache.add(entry);
+
+      return;
+    }
+  }
+
+  const limit = getPacketCacheLimit();
+
+  if (packet.data.byteLength > limit) {
+    return;
+  }
+
+  packetCache.add({
+    workerFile,
+    type,
+    streamIndex,
+    start: Math.min(time, packet.timestamp),
+    end: Math.max(time, packet.timestamp),
+    packet: { ...packet, data: packet.data.slice() },
+  });
+  packetCacheBytes += packet.data.byteLength;
+
+  for (const entry of packetCache) {
+    if (packetCacheBytes <= limit) break;
+
+    packetCache.delete(entry);
+    packetCacheBytes -= entry.packet.data.byteLength;
+  }
+}
+
+function dropCachedPackets(workerFile) {
+  for (const entry of packetCache) {
+    if (entry.workerFile === workerFile) {
+      packetCache.delete(entry);
+      packetCacheBytes -= entry.packet.data.byteLength;
+    }
+  }
+}
+
+function getCachedPacketSize(workerFile) {
+  let size = 0;
+
+  for (const entry of packetCache) {
+    if (entry.workerFile === workerFile) {
+      size += entry.packet.data.byteLength;
+    }
+  }
+
+  return size;
+}
+
+// ============ segment queue ============
+const segmentQueues = new Map(); // segment stream id -> queue
+
+function getSegmentQueue(streamId) {
+  let queue = segmentQueues.get(streamId);
+
+  if (!queue) {
+    queue = {
+      chunks: [],
+      offset: 0,
+      ended: false,
+      waiting: null,
+    };
+    segmentQueues.set(streamId, queue);
+  }
+
+  return queue;
+}
+
+function endSegmentQueue(queue) {
+  queue.ended = true;
+
+  if (queue.waiting) {
+    queue.waiting();
+    queue.waiting = null;
+  }
+}
+
+function appendSegment(streamId, data, last = false) {
+  const queue = getSegmentQueue(streamId);
+
+  if (queue.ended) {
+    throw new Error("segment stream already ended");
+  }
+
+  // the segment was transferred or copied to the worker, a view of it is enough
+  if (data && data.byteLength > 0) {
+    queue.chunks.push(ArrayBuffer.isView(data) ? data : new Uint8Array(data));
+  }
+
+  if (last) {
+    endSegmentQueue(queue);
+  } else if (queue.waiting) {
+    queue.waiting();
+    queue.waiting = null;
+  }
+}
+
+async function readSegmentPacket(msgId, format = "mpegts", readAhead, packetRing) {
+  const queue = getSegmentQueue(msgId);
+  const sender = createPacketSender(msgId, readAhead, packetRing);
+  // stop reading also has to wake a reader blocked on segment data
+  const stopListener = (event) => {
+    const { type, msgId: stopMsgId } = event.data;
+
+    if (type === "StopReadAVPacket" && stopMsgId === msgId) {
+      queue.chunks = [];
+      endSegmentQueue(queue);
+    }
+  };
+
+  self.addEventListener("message", stopListener);
+
+  try {
+    const result = await Module.read_segment_packet(format, {
+      sendAVPacket: sender.sendAVPacket,
+      waitAVPacketCredit: sender.waitAVPacketCredit,
+      sendAVStreams: genSendAVStreams(msgId),
+      readSegmentData: genReadSegmentData(queue),
+      waitSegmentData: genWaitSegmentData(queue),
     });
 
     if (result === 0) {
       throw new Error("return 0");
     }
   } catch(e) {
-    throw new Error("read_av_packet failed: " + e.message);
+    throw new Error("read_segment_packet failed: " + e.message);
   } finally {
-    workerFile.unmount()
+    self.removeEventListener("message", stopListener);
+    sender.close();
+    segmentQueues.delete(msgId);
   }
 }
 
 // ============ js methods called in c ============
-// eslint-disable-next-line @typescript-eslint/no-unused-vars
-function genSendAVPacket(messageId) {
-  return function sendAVPacket(avPacket) {
+// copy buffered segment bytes into wasm memory, -1 means no data yet, 0 means end
+function genReadSegmentData(queue) {
+  return function readSegmentData(ptr, size) {
+    const { chunks } = queue;
+
+    if (chunks.length === 0) {
+      return queue.ended ? 0 : -1;
+    }
+
+    let copied = 0;
+
+    while (copied < size && chunks.length > 0) {
+      const chunk = chunks[0];
+      const length = Math.min(size - copied, chunk.byteLength - queue.offset);
+
+      HEAPU8.set(chunk.subarray(queue.offset, queue.offset + length), ptr + copied);
+      copied += length;
+      queue.offset += length;
+
+      if (queue.offset === chunk.byteLength) {
+        chunks.shift();
+        queue.offset = 0;
+      }
+    }
+
+    return copied;
+  }
+}
+
+function genWaitSegmentData(queue) {
+  return function waitSegmentData() {
     return new Promise((resolve) => {
-        const postData = {
-          type: "AVPacketStream",
-          msgId: messageId,
-          result: null,
-        };
-
-        if (avPacket === 0) {
-          self.postMessage(postData);
-          resolve(1);
-          return;
-        }
+      queue.waiting = resolve;
+    });
+  }
+}
 
-        const result = avPacketToObject(avPacket);
+function genSendAVStreams(messageId) {
+  return function sendAVStreams(avStreamList) {
+    const result = [];
 
-        postData.result = result;
-        self.postMessage(postData, [result.data.buffer]);
+    for (let i = 0; i < avStreamList.streams.size(); i++) {
+      result.push(avStreamToObject(avStreamList.streams.get(i)));
+    }
+
+    avStreamList.streams.delete();
 
-        const msgListener = (event) => {
-          const { type, msgId } = event.data;
+    self.postMessage(
+      {
+        type: "SegmentAVStreams",
+        msgId: messageId,
+        result,
+      },
+      result.map((stream) => stream.extradata.buffer)
+    );
+  }
+}
 
-          if (msgId === messageId) {
-            if (type === "ReadNextAVPacket") {
-              self.removeEventListener("message", msgListener);
-              resolve(1);
-            } else if (type === "StopReadAVPacket") {
-              self.removeEventListener("message", msgListener);
-              resolve(0);
-            }
-          }
-        };
+// size of a packet in read-ahead units, must match the main thread queuing strategy
+function getReadAheadSize(packet, unit) {
+  if (unit === "bytes") {
+    return packet.data.byteLength;
+  }
 
-        self.addEventListener("message", msgListener);
-      });
+  if (unit === "seconds") {
+    return Math.max(packet.duration, 0);
   }
+
+  return 1;
+}
+
+/**
+ * Long reads are run in slices: a sender gives the worker back to the request scheduler
+ * once its slice is over, and resumes after the requests waiting at the same or a higher priority,
+ * in the same call on the same open source. Only requests that do not suspend run between
+ * slices, the scheduler holds other long reads back until the suspended call returns.
+ */
+function createSlicer() {
+  const scheduler = Module.requestScheduler;
+  // senders are created before the first await of a request, while it is the current one
+  const priority = scheduler.currentPriority();
+  let sliceStart = performance.now();
+
+  return {
+    shouldYield: () => scheduler.shouldYield(sliceStart),
+    restart() {
+      sliceStart = performance.now();
+    },
+    async nextSlice() {
+      await scheduler.nextSlice(priority);
+      sliceStart = performance.now();
+    },
+  };
+}
+
+/**
+ * slicer of a read loop in c that returns nothing until it ends, the next slice is 0
+ * once the session of the source is closed
+ */
+function createSourceSlicer(source) {
+  const slicer = createSlicer();
+
+  return {
+    shouldYield: () => slicer.shouldYield() ? 1 : 0,
+    async nextSlice() {
+      await slicer.nextSlice();
+
+      return typeof source === "number" && !sessions.has(source) ? 0 : 1;
+    },
+  };
+}
+
+/**
+ * Results are posted as `type` messages while less than highWaterMark is unconsumed, in
+ * the units of their sizes. The main thread reports the consumed size by ReadNextAVPacket
+ * messages and stops the stream by StopReadAVPacket. A send also asks to wait once the
+ * slice of the read is over, the wait gives way to other requests then.
+ */
+function createCreditSender(messageId, type, highWaterMark) {
+  const slicer = createSlicer();
+  let sent = 0;
+  let consumed = 0;
+  let stopped = false;
+  let waiting = null;
+  let yielding = false;
+
+  const hasCredit = () => sent - consumed < highWaterMark;
+
+  const wake = () => {
+    if (waiting && (stopped || hasCredit())) {
+      waiting(stopped ? 0 : 1);
+      waiting = null;
+    }
+  };
+
+  const msgListener = (event) => {
+    const { type, msgId, data } = event.data;
+
+    if (msgId !== messageId) return;
+
+    if (type === "ReadNextAVPacket") {
+      consumed = Math.max(consumed, data.consumed);
+      wake();
+    } else if (type === "StopReadAVPacket") {
+      stopped = true;
+      wake();
+    }
+  };
+
+  self.addEventListener("message", msgListener);
+
+  return {
+    isStopped: () => stopped,
+    post(result, transfer, size) {
+      self.postMessage({
+        type,
+        msgId: messageId,
+        result,
+      }, transfer);
+      sent += size;
+    },
+    // null ends the stream
+    end() {
+      self.postMessage({
+        type,
+        msgId: messageId,
+        result: null,
+      });
+    },
+    // 1 to read on, -1 to wait for the consumer or for the next slice
+    next(hasSpace = hasCredit()) {
+      if (!hasSpace) return -1;
+
+      yielding = slicer.shouldYield();
+
+      return yielding ? -1 : 1;
+    },
+    // 1 to read on, 0 once stopped, waitSpace replaces the wait for the consumer
+    async waitCredit(waitSpace) {
+      if (yielding) {
+        yielding = false;
+        await slicer.nextSlice();
+        return stopped ? 0 : 1;
+      }
+
+      const result = waitSpace
+        ? await waitSpace()
+        : await new Promise((resolve) => {
+          waiting = resolve;
+          wake();
+        });
+
+      slicer.restart();
+
+      return result;
+    },
+    close() {
+      self.removeEventListener("message", msgListener);
+    },
+  };
 }
 
+/**
+ * Packets are sent as long as the main thread queue is below its high water mark.
+ * With a shared packet ring, packets are written to the ring instead and the ring
+ * capacity bounds the read-ahead, only packets too large for it are posted.
+ */
+function createPacketSender(messageId, readAhead, ring) {
+  const { highWaterMark = 1, unit = "packets" } = readAhead || {};
+  const sender = createCreditSender(messageId, "AVPacketStream", ring ? Infinity : highWaterMark);
+  let pending = null; // packet waiting for space in the ring
+
+  const postPacket = (avPacket) => {
+    const result = avPacketToObject(avPacket);
+
+    sender.post(result, [result.data.buffer], getReadAheadSize(result, unit));
+  };
+
+  const writeToRing = (avPacket) => {
+    if (!ring.fits(avPacket.size)) {
+      if (!ring.writeOutOfBand()) {
+        return false;
+      }
+      postPacket(avPacket);
+      return true;
+    }
+
+    if (!ring.write(avPacket)) {
+      return false;
+    }
+    avPacket.delete();
+    return true;
+  };
+
+  const isStopped = () => sender.isStopped() || (ring && ring.stopped);
+
+  const waitRingSpace = async () => {
+    while (pending) {
+      if (isStopped()) {
+        pending.delete();
+        pending = null;
+        return 0;
+      }
+
+      await ring.waitWritable();
+
+      if (writeToRing(pending)) {
+        pending = null;
+      }
+    }
+
+    return 1;
+  };
+
+  return {
+    // 1 means continue, 0 means stop, -1 means wait for the consumer by waitAVPacketCredit
+    sendAVPacket(avPacket) {
+      if (avPacket === 0) {
+        if (ring) {
+          ring.close();
+        }
+        sender.end();
+        return 1;
+      }
+
+      if (isStopped()) {
+        avPacket.delete();
+        return 0;
+      }
+
+      if (ring) {
+        if (writeToRing(avPacket)) {
+          return sender.next(true);
+        }
+        pending = avPacket;
+        return -1;
+      }
+
+      postPacket(avPacket);
+
+      return sender.next();
+    },
+    waitAVPacketCredit() {
+      return sender.waitCredit(ring ? waitRingSpace : undefined);
+    },
+    close() {
+      sender.close();
+
+      if (pending) {
+        pending.delete();
+        pending = null;
+      }
+    },
+  };
+}
+
+/**
+ * Output chunks are posted while less than highWaterMark bytes are unconsumed
+ */
+function createChunkSender(messageId, highWaterMark = 4 * 1024 * 1024) {
+  const sender = createCreditSender(messageId, "ExportChunk", highWaterMark);
+
+  return {
+    // 1 means continue, 0 means stop, -1 means wait for the consumer by waitChunkCredit
+    writeChunk(ptr, size) {
+      if (ptr === 0 && size === 0) {
+        sender.end();
+        return 1;
+      }
+
+      if (sender.isStopped()) return 0;
+
+      const chunk = HEAPU8.slice(ptr, ptr + size);
+
+      sender.post(chunk, [chunk.buffer], size);
+
+      return sender.next();
+    },
+    waitChunkCredit: () => sender.waitCredit(),
+    close: () => sender.close(),
+  };
+}
+
+/**
+ * GOPs are posted while less than highWaterMark GOPs are unconsumed
+ */
+function createGOPSender(messageId, highWaterMark = 2) {
+  const sender = createCreditSender(messageId, "GOPStream", highWaterMark);
+
+  return {
+    // 1 means continue, 0 means stop, -1 means wait for the consumer by waitGOPCredit
+    sendGOP(avPacketList) {
+      if (avPacketList === 0) {
+        sender.end();
+        return 1;
+      }
+
+      const { packets } = avPacketList;
+
+      if (sender.isStopped()) {
+        packets.delete();
+        return 0;
+      }
+
+      const result = [];
+
+      for (let i = 0; i < packets.size(); i++) {
+        result.push(avPacketToObject(packets.get(i)));
+      }
+
+      packets.delete();
+      sender.post(result, result.map(({ data }) => data.buffer), 1);
+
+      return sender.next();
+    },
+    waitGOPCredit: () => sender.waitCredit(),
+    close: () => sender.close(),
+  };
+}
+
+// request id -> whether it has been cancelled, overridden by the worker
+function isRequestCancelled() {
+  return false;
+}
+
+// priority of the request being started, whether a slice is over,
+// and the next turn of a slice at a priority, overridden by the worker
+const requestScheduler = {
+  currentPriority: () => 0,
+  shouldYield: () => false,
+  nextSlice: () => Promise.resolve(),
+};
+
 function setAVLogLevel(level) {
   logLevel = level;
   Module.set_av_log_level(level);
 }
 
+// probe size and AVIO buffers are scaled down to the budget
+function setMemoryBudget(budget) {
+  memoryBudget = budget > 0 ? budget : 0;
+  Module.set_memory_budget(memoryBudget);
+}
+
+/**
+ * the wasm memory only grows, heap memory freed by malloc stays reserved, fragmentation
+ * is the free share of the malloc arena that only a new module instance gives back
+ */
+function getMemoryStats() {
+  return {
+    heapSize: HEAPU8.length,
+    heapUsed: Module.get_heap_used(),
+    fragmentation: Module.get_heap_fragmentation(),
+    memoryBudget,
+  };
+}
+
 // ============ Module Register ============
+Module.openSource = openSource;
+Module.closeSource = closeSource;
+Module.getOpenSources = getOpenSources;
+Module.getIOStats = getIOStats;
+Module.startIOTrace = startIOTrace;
+Module.stopIOTrace = stopIOTrace;
 Module.getAVStream = getAVStream;
 Module.getAVStreams = getAVStreams;
 Module.getMediaInfo = getMediaInfo;
+Module.probeMany = probeMany;
 Module.getAVPacket = getAVPacket;
 Module.getAVPackets = getAVPackets;
+Module.getSampleTable = getSampleTable;
+Module.getSamples = getSamples;
+Module.analyzeStream = analyzeStream;
 Module.readAVPacket = readAVPacket;
+Module.startPlayback = startPlayback;
+Module.readKeyframePacket = readKeyframePacket;
+Module.readReverseGOP = readReverseGOP;
+Module.readSegmentPacket = readSegmentPacket;
+Module.exportClip = exportClip;
+Module.buildSeekIndex = buildSeekIndex;
+Module.appendSegment = appendSegment;
 Module.setAVLogLevel = setAVLogLevel;
+Module.setMemoryBudget = setMemoryBudget;
+Module.getMemoryStats = getMemoryStats;
+Module.isRequestCancelled = isRequestCancelled;
+Module.requestScheduler = requestScheduler;
@@ -2,6 +2,9 @@
 #include <sstream>
 #include <cstdint>
 #include <vector>
+#include <algorithm>
+#include <map>
+#include <malloc.h>
 #include <emscripten.h>
 #include <emscripten/bind.h>
 #include <emscripten/val.h>
@@ -77,6 +80,7 @@ typedef struct WebAVStream
 
 typedef struct WebAVPacket
 {
+    int stream_index;
     int keyframe;
     double timestamp;
     double duration;
@@ -99,6 +103,58 @@ typedef struct WebAVPacketList
     std::vector<WebAVPacket> packets;
 } WebAVPacketList;
 
+typedef struct WebSampleTable
+{
+    int stream_index;
+    std::vector<double> timestamps;
+    std::vector<double> offsets;
+    std::vector<int> sizes;
+    std::vector<uint8_t> keyframes;
+    val get_timestamps() const {
+        return val(typed_memory_view(timestamps.size(), timestamps.data()));
+    }
+    val get_offsets() const {
+        return val(typed_memory_view(offsets.size(), offsets.data()));
+    }
+    val get_sizes() const {
+        return val(typed_memory_view(sizes.size(), sizes.data()));
+    }
+    val get_keyframes() const {
+        return val(typed_memory_view(keyframes.size(), keyframes.data()));
+    }
+} WebSampleTable;
+
+typedef struct WebGOPLengthCount
+{
+    int length;
+    int count;
+} WebGOPLengthCount;
+
+typedef struct WebStreamAnalysis
+{
+    int stream_index;
+    int packet_count;
+    int keyframe_count;
+    double total_size;
+    int max_packet_size;
+    double start_time;
+    double end_time;
+    /** GOP length in packets -> number of GOPs */
+    std::vector<WebGOPLengthCount> gop_histogram;
+    double min_keyframe_interval;
+    double max_keyframe_interval;
+    double avg_keyframe_interval;
+    /** bits per second of each bucket from start_time */
+    double bitrate_bucket;
+    std::vector<double> bitrate_series;
+    int has_b_frames;
+    int missing_pts_count;
+    int non_monotonic_dts_count;
+    int pts_before_dts_count;
+    /** dts in seconds where a timestamp jump was detected */
+    std::vector<double> discontinuities;
+} WebStreamAnalysis;
+
 typedef struct WebMediaInfo
 {
     std::string format_name;
@@ -169,6 +225,7 @@ void gen_web_packet(WebAVPacket &web_packet, AVPacket *packet, AVStream *stream)
         packet_timestamp = packet->dts * av_q2d(stream->time_base);
     }
 
+    web_packet.stream_index = packet->stream_index;
     web_packet.keyframe = packet->flags & AV_PKT_FLAG_KEY;
     web_packet.timestamp = packet_timestamp;
     web_packet.duration = packet->duration * av_q2d(stream->time_base);
@@ -292,12 +349,454 @@ void gen_web_stream(WebAVStream &web_stream, AVStream *stream, AVFormatContext *
     }
 }
 
+EM_JS(int, is_request_cancelled, (int request_id), {
+    return Module.isRequestCancelled(request_id) ? 1 : 0;
+});
+
+// AVIOInterruptCB, checked by FFmpeg in the read path of cancellable requests
+int interrupt_callback(void *opaque)
+{
+    int request_id = (int)(intptr_t)opaque;
+
+    return request_id >= 0 && is_request_cancelled(request_id);
+}
+
+AVFormatContext *alloc_format_context(int request_id)
+{
+    AVFormatContext *fmt_ctx = avformat_alloc_context();
+
+    if (fmt_ctx && request_id >= 0)
+    {
+        fmt_ctx->interrupt_callback.callback = interrupt_callback;
+        fmt_ctx->interrupt_callback.opaque = (void *)(intptr_t)request_id;
+    }
+
+    return fmt_ctx;
+}
+
+#define DEFAULT_PROBE_SIZE 5000000 // FFmpeg default
+#define MIN_PROBE_SIZE 262144
+#define MIN_IO_BUFFER_SIZE 4096
+
+// bytes the worker should stay within, 0 for no budget
+double memory_budget = 0;
+
+void set_memory_budget(double budget)
+{
+    memory_budget = budget > 0 ? budget : 0;
+}
+
+// bytes in use by malloc
+double get_heap_used()
+{
+    return (double)mallinfo().uordblks;
+}
+
+/**
+ * Share of the malloc arena that is free, held by the module instance until it is recycled.
+ * Memory above the arena was never handed out by malloc and does not count.
+ */
+double get_heap_fragmentation()
+{
+    struct mallinfo info = mallinfo();
+
+    return info.arena > 0 ? (double)info.fordblks / info.arena : 0;
+}
+
+/**
+ * AVIO buffer size scaled down to the memory budget
+ */
+int budget_io_buffer_size(int size)
+{
+    if (memory_budget <= 0)
+    {
+        return size;
+    }
+
+    return std::min(size, std::max(MIN_IO_BUFFER_SIZE, (int)(memory_budget / 1024)));
+}
+
+/**
+ * avformat_open_input with the probe size scaled down to the memory budget,
+ * find_stream_info keeps up to probesize bytes of packets
+ */
+int open_input(AVFormatContext **fmt_ctx, const char *url, const AVInputFormat *input_format = NULL)
+{
+    AVDictionary *options = NULL;
+    int ret;
+
+    if (memory_budget > 0)
+    {
+        int64_t probe_size = std::clamp((int64_t)(memory_budget / 32), (int64_t)MIN_PROBE_SIZE, (int64_t)DEFAULT_PROBE_SIZE);
+
+        av_dict_set_int(&options, "probesize", probe_size, 0);
+    }
+
+    ret = avformat_open_input(fmt_ctx, url, input_format, &options);
+    av_dict_free(&options);
+
+    return ret;
+}
+
+/**
+ * Whether the index entries of the demuxer cover the whole file on open (MP4/MOV sample
+ * table, Matroska cues, AVI idx1, ...), instead of the generic index built while reading.
+ */
+int has_seek_index(AVFormatContext *fmt_ctx, AVStream *stream)
+{
+    return !(fmt_ctx->iformat->flags & AVFMT_GENERIC_INDEX) && avformat_index_get_entries_count(stream) > 0;
+}
+
+/**
+ * Seek points of the open files, for demuxers without an index of their own (FLV without
+ * keyframe metadata, MPEG-TS/PS, AVI without idx1). The keyframes every read goes through
+ * are recorded per file and added back by av_add_index_entry on the next open, and a seek
+ * into a range whose keyframes are all known is a single positioned read.
+ */
+typedef struct StreamSeekIndex
+{
+    // keyframe pts -> byte position, in stream time base
+    std::map<int64_t, int64_t> points;
+    // pts ranges read through from a keyframe, start -> end, every keyframe in them is a point
+    std::map<int64_t, int64_t> covered;
+} StreamSeekIndex;
+
+typedef struct SeekRun
+{
+    int64_t start; // first keyframe read
+    int64_t end;   // last pts read
+} SeekRun;
+
+typedef struct SeekPointRecorder
+{
+    // seek points of the file per stream, NULL when its demuxer has an index of its own
+    std::map<int, StreamSeekIndex> *streams;
+    // continuous reads since the last seek, per stream
+    std::map<int, SeekRun> runs;
+} SeekPointRecorder;
+
+std::map<std::string, std::map<int, StreamSeekIndex>> seek_indices; // file path -> stream index -> seek points
+
+// demuxers whose packets carry their timestamps and that resync at any packet position
+const char *POSITIONED_SEEK_FORMATS[] = {"flv", "mpegts", "mpeg"};
+
+/**
+ * Add the recorded seek points of a file to its streams, and start recording
+ * when its demuxer has no index of its own
+ */
+SeekPointRecorder open_seek_index(const std::string &filename, AVFormatContext *fmt_ctx)
+{
+    SeekPointRecorder recorder = {
+        .streams = NULL,
+        .runs = std::map<int, SeekRun>(),
+    };
+    auto file_index = seek_indices.find(filename);
+
+    if (file_index == seek_indices.end())
+    {
+        for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++)
+        {
+            if (has_seek_index(fmt_ctx, fmt_ctx->streams[i]))
+            {
+                return recorder;
+            }
+        }
+
+        recorder.streams = &seek_indices[filename];
+
+        return recorder;
+    }
+
+    for (auto &[stream_index, index] : file_index->second)
+    {
+        if (stream_index >= (int)fmt_ctx->nb_streams)
+        {
+            continue;
+        }
+
+        for (auto &[timestamp, pos] : index.points)
+        {
+            av_add_index_entry(fmt_ctx->streams[stream_index], pos, timestamp, 0, 0, AVINDEX_KEYFRAME);
+        }
+    }
+    recorder.streams = &file_index->second;
+
+    return recorder;
+}
+
+void record_seek_point(SeekPointRecorder &recorder, AVPacket *packet)
+{
+    int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+
+    if (!recorder.streams || timestamp == AV_NOPTS_VALUE)
+    {
+        return;
+    }
+
+    auto run = recorder.runs.find(packet->stream_index);
+
+    // a run starts at the first keyframe, the delta frames before it may follow an unknown keyframe
+    if (run == recorder.runs.end())
+    {
+        if (!(packet->flags & AV_PKT_FLAG_KEY))
+        {
+            return;
+        }
+
+        run = recorder.runs.emplace(packet->stream_index, SeekRun{timestamp, timestamp}).first;
+    }
+
+    run->second.end = std::max(run->second.end, timestamp);
+
+    if ((packet->flags & AV_PKT_FLAG_KEY) && packet->pos >= 0)
+    {
+        (*recorder.streams)[packet->stream_index].points[timestamp] = packet->pos;
+    }
+}
+
+/**
+ * Mark the ranges read since the last seek as covered, up to the end of the file when eof
+ */
+void end_seek_runs(SeekPointRecorder &recorder, bool eof)
+{
+    if (!recorder.streams)
+    {
+        return;
+    }
+
+    for (auto &[stream_index, run] : recorder.runs)
+    {
+        std::map<int64_t, int64_t> &covered = (*recorder.streams)[stream_index].covered;
+        int64_t start = run.start;
+        int64_t end = eof ? INT64_MAX : run.end;
+        auto it = covered.upper_bound(start);
+
+        // merge with the overlapping ranges
+        if (it != covered.begin() && std::prev(it)->second >= start)
+        {
+            --it;
+            start = it->first;
+            end = std::max(end, it->second);
+            it = covered.erase(it);
+        }
+
+        while (it != covered.end() && it->first <= end)
+        {
+            end = std::max(end, it->second);
+            it = covered.erase(it);
+        }
+
+        covered[start] = end;
+    }
+
+    recorder.runs.clear();
+}
+
+/**
+ * The keyframe at or before timestamp, NULL unless every keyframe around it is known
+ */
+const std::pair<const int64_t, int64_t> *find_seek_point(SeekPointRecorder &recorder, int stream_index, int64_t timestamp)
+{
+    auto index = recorder.streams->find(stream_index);
+
+    if (index == recorder.streams->end())
+    {
+        return NULL;
+    }
+
+    auto range = index->second.covered.upper_bound(timestamp);
+
+    if (range == index->second.covered.begin() || std::prev(range)->second < timestamp)
+    {
+        return NULL;
+    }
+
+    auto point = index->second.points.upper_bound(timestamp);
+
+    if (point == index->second.points.begin())
+    {
+        return NULL;
+    }
+
+    return &*std::prev(point);
+}
+
+#define MAX_SEEK_POINT_CHECK_PACKETS 32
+
+/**
+ * Move the demuxer to a recorded keyframe, only when the first packet of the stream read
+ * there is that keyframe. The packets read to check it are read again from the AVIO buffer.
+ */
+int seek_to_point(AVFormatContext *fmt_ctx, int stream_index, int64_t timestamp, int64_t pos)
+{
+    AVPacket *packet = av_packet_alloc();
+    int found = 0;
+
+    if (!packet)
+    {
+        return 0;
+    }
+
+    avformat_flush(fmt_ctx);
+
+    if (avio_seek(fmt_ctx->pb, pos, SEEK_SET) >= 0)
+    {
+        for (int i = 0; i < MAX_SEEK_POINT_CHECK_PACKETS && av_read_frame(fmt_ctx, packet) >= 0; i++)
+        {
+            int64_t packet_timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            int is_stream = packet->stream_index == stream_index;
+
+            found = is_stream && packet->pos == pos && packet_timestamp == timestamp && (packet->flags & AV_PKT_FLAG_KEY);
+            av_packet_unref(packet);
+
+            if (is_stream)
+            {
+                break;
+            }
+        }
+    }
+
+    av_packet_free(&packet);
+    avformat_flush(fmt_ctx);
+
+    return found && avio_seek(fmt_ctx->pb, pos, SEEK_SET) >= 0;
+}
+
+/**
+ * av_seek_frame, or a positioned read at a recorded keyframe for a backward seek into a
+ * covered range, instead of the binary search or scan of demuxers without an index.
+ * Seek points not matching the file any more are dropped.
+ */
+int seek_frame(AVFormatContext *fmt_ctx, SeekPointRecorder &recorder, int stream_index, int64_t timestamp, int flags)
+{
+    end_seek_runs(recorder, false);
+
+    bool positioned = recorder.streams && flags == AVSEEK_FLAG_BACKWARD &&
+        std::any_of(std::begin(POSITIONED_SEEK_FORMATS), std::end(POSITIONED_SEEK_FORMATS),
+                    [fmt_ctx](const char *name) { return strcmp(fmt_ctx->iformat->name, name) == 0; });
+
+    if (positioned)
+    {
+        const std::pair<const int64_t, int64_t> *point = find_seek_point(recorder, stream_index, timestamp);
+
+        if (point)
+        {
+            if (seek_to_point(fmt_ctx, stream_index, point->first, point->second))
+            {
+                return 0;
+            }
+
+            av_log(NULL, AV_LOG_WARNING, "Recorded seek point does not match, dropping the seek index of the stream\n");
+            recorder.streams->erase(stream_index);
+        }
+    }
+
+    return av_seek_frame(fmt_ctx, stream_index, timestamp, flags);
+}
+
+void clear_seek_index(std::string filename)
+{
+    seek_indices.erase(filename);
+}
+
+/**
+ * Read a whole file once to record the seek points of every stream, at the priority of the
+ * request between other requests. Returns the number of seek points, 0 when the demuxer
+ * has an index of its own, -1 on failure.
+ */
+int build_seek_index(std::string filename, val js_caller)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    int ret;
+
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
+        avformat_close_input(&fmt_ctx);
+        return -1;
+    }
+
+    if ((ret = avformat_find_stream_info(fmt_ctx, NULL)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
+        avformat_close_input(&fmt_ctx);
+        return -1;
+    }
+
+    SeekPointRecorder recorder = open_seek_index(filename, fmt_ctx);
+
+    if (!recorder.streams)
+    {
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+
+    if (!packet)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate packet\n");
+        avformat_close_input(&fmt_ctx);
+        return -1;
+    }
+
+    if ((ret = seek_frame(fmt_ctx, recorder, -1, 0, AVSEEK_FLAG_BACKWARD)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot seek to the start\n");
+        avformat_close_input(&fmt_ctx);
+        av_packet_free(&packet);
+        return -1;
+    }
+
+    while ((ret = av_read_frame(fmt_ctx, packet)) >= 0)
+    {
+        record_seek_point(recorder, packet);
+        av_packet_unref(packet);
+
+        // give way to other requests once the slice is over, 0 when the source is closed
+        if (js_caller.call<int>("shouldYield") && js_caller.call<val>("nextSlice").await().as<int>() == 0)
+        {
+            break;
+        }
+    }
+
+    end_seek_runs(recorder, ret == AVERROR_EOF);
+
+    int count = 0;
+
+    for (auto &[stream_index, index] : *recorder.streams)
+    {
+        count += index.points.size();
+    }
+
+    avformat_close_input(&fmt_ctx);
+    av_packet_free(&packet);
+
+    return count;
+}
+
+/**
+ * Push stream selection down to the demuxer, so the payloads of other streams
+ * are skipped (mov seeks to the next wanted sample, flv/avi skip the packet)
+ * instead of read into packets and unreferenced.
+ */
+void discard_other_streams(AVFormatContext *fmt_ctx, int stream_index)
+{
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++)
+    {
+        if ((int)i != stream_index)
+        {
+            fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+}
+
 WebAVStream get_av_stream(std::string filename, int type, int wanted_stream_nb)
 {
     AVFormatContext *fmt_ctx = NULL;
     int ret;
 
-    if ((ret = avformat_open_input(&fmt_ctx, filename.c_str(), NULL, NULL)) < 0)
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
     {
         av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
         avformat_close_input(&fmt_ctx);
@@ -335,7 +834,7 @@ WebAVStreamList get_av_streams(std::string filename)
     AVFormatContext *fmt_ctx = NULL;
     int ret;
 
-    if ((ret = avformat_open_input(&fmt_ctx, filename.c_str(), NULL, NULL)) < 0)
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
     {
         av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
         avformat_close_input(&fmt_ctx);
@@ -372,7 +871,7 @@ WebMediaInfo get_media_info(std::string filename) {
     AVFormatContext *fmt_ctx = NULL;
     int ret;
 
-    if ((ret = avformat_open_input(&fmt_ctx, filename.c_str(), NULL, NULL)) < 0)
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
     {
         av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
         avformat_close_input(&fmt_ctx);
@@ -411,12 +910,12 @@ WebMediaInfo get_media_info(std::string filename) {
     return media_info;
 }
 
-WebAVPacket get_av_packet(std::string filename, double timestamp, int type, int wanted_stream_nb, int seek_flag)
+WebAVPacket get_av_packet(std::string filename, double timestamp, int type, int wanted_stream_nb, int seek_flag, int request_id)
 {
-    AVFormatContext *fmt_ctx = NULL;
+    AVFormatContext *fmt_ctx = alloc_format_context(request_id);
     int ret;
 
-    if ((ret = avformat_open_input(&fmt_ctx, filename.c_str(), NULL, NULL)) < 0)
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
     {
         av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
         avformat_close_input(&fmt_ctx);
@@ -430,6 +929,8 @@ WebAVPacket get_av_packet(std::string filename, double timestamp, int type, int
         throw std::runtime_error("Cannot find stream information");
     }
 
+    SeekPointRecorder seek_points = open_seek_index(filename, fmt_ctx);
+
     int stream_index = av_find_best_stream(fmt_ctx, (AVMediaType)type, wanted_stream_nb, -1, NULL, 0);
 
     if (stream_index < 0)
@@ -439,6 +940,8 @@ WebAVPacket get_av_packet(std::string filename, double timestamp, int type, int
         throw std::runtime_error("Cannot find wanted stream in the input file");
     }
 
+    discard_other_streams(fmt_ctx, stream_index);
+
     AVPacket *packet = NULL;
     packet = av_packet_alloc();
 
@@ -452,7 +955,7 @@ WebAVPacket get_av_packet(std::string filename, double timestamp, int type, int
     int64_t int64_timestamp = (int64_t)(timestamp * AV_TIME_BASE);
     int64_t seek_time_stamp = av_rescale_q(int64_timestamp, AV_TIME_BASE_Q, fmt_ctx->streams[stream_index]->time_base);
 
-    if ((ret = av_seek_frame(fmt_ctx, stream_index, seek_time_stamp, seek_flag)) < 0)
+    if ((ret = seek_frame(fmt_ctx, seek_points, stream_index, seek_time_stamp, seek_flag)) < 0)
     {
         av_log(NULL, AV_LOG_ERROR, "Cannot seek to the specified timestamp\n");
         avformat_close_input(&fmt_ctx);
@@ -461,8 +964,10 @@ WebAVPacket get_av_packet(std::string filename, double timestamp, int type, int
         throw std::runtime_error("Cannot seek to the specified timestamp");
     }
 
-    while (av_read_frame(fmt_ctx, packet) >= 0)
+    while ((ret = av_read_frame(fmt_ctx, packet)) >= 0)
     {
+        record_seek_point(seek_points, packet);
+
         if (packet->stream_index == stream_index)
         {
             break;
@@ -470,6 +975,14 @@ WebAVPacket get_av_packet(std::string filename, double timestamp, int type, int
         av_packet_unref(packet);
     }
 
+    if (ret == AVERROR_EXIT)
+    {
+        av_log(NULL, AV_LOG_INFO, "Request cancelled\n");
+        avformat_close_input(&fmt_ctx);
+        av_packet_free(&packet);
+        throw std::runtime_error("Request cancelled");
+    }
+
     if (!packet)
     {
         av_log(NULL, AV_LOG_ERROR, "Failed to get av packet at timestamp\n");
@@ -480,6 +993,7 @@ WebAVPacket get_av_packet(std::string filename, double timestamp, int type, int
     WebAVPacket web_packet;
 
     gen_web_packet(web_packet, packet, fmt_ctx->streams[stream_index]);
+    end_seek_runs(seek_points, false);
 
     avformat_close_input(&fmt_ctx);
     av_packet_unref(packet);
@@ -493,7 +1007,7 @@ WebAVPacketList get_av_packets(std::string filename, double timestamp, int seek_
     AVFormatContext *fmt_ctx = NULL;
     int ret;
 
-    if ((ret = avformat_open_input(&fmt_ctx, filename.c_str(), NULL, NULL)) < 0)
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
     {
         av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
         avformat_close_input(&fmt_ctx);
@@ -507,6 +1021,8 @@ WebAVPacketList get_av_packets(std::string filename, double timestamp, int seek_
         throw std::runtime_error("Cannot find stream information");
     }
 
+    SeekPointRecorder seek_points = open_seek_index(filename, fmt_ctx);
+
     int num_streams = fmt_ctx->nb_streams;
     int num_packets = num_streams;
     WebAVPacketList web_packet_list = {
@@ -529,7 +1045,7 @@ WebAVPacketList get_av_packets(std::string filename, double timestamp, int seek_
         int64_t int64_timestamp = (int64_t)(timestamp * AV_TIME_BASE);
         int64_t seek_time_stamp = av_rescale_q(int64_timestamp, AV_TIME_BASE_Q, fmt_ctx->streams[stream_index]->time_base);
 
-        if ((ret = av_seek_frame(fmt_ctx, stream_index, seek_time_stamp, seek_flag)) < 0)
+        if ((ret = seek_frame(fmt_ctx, seek_points, stream_index, seek_time_stamp, seek_flag)) < 0)
         {
             av_log(NULL, AV_LOG_ERROR, "Cannot seek to the specified timestamp\n");
             throw std::runtime_error("Cannot seek to the specified timestamp");
@@ -537,6 +1053,8 @@ WebAVPacketList get_av_packets(std::string filename, double timestamp, int seek_
 
         while (av_read_frame(fmt_ctx, packet) >= 0)
         {
+            record_seek_point(seek_points, packet);
+
             if (packet->stream_index == stream_index)
             {
                 break;
@@ -553,6 +1071,7 @@ WebAVPacketList get_av_packets(std::string filename, double timestamp, int seek_
         gen_web_packet(web_packet_list.packets[stream_index], packet, fmt_ctx->streams[stream_index]);
     }
 
+    end_seek_runs(seek_points, false);
     av_packet_unref(packet);
     av_packet_free(&packet);
     avformat_close_input(&fmt_ctx);
@@ -560,23 +1079,31 @@ WebAVPacketList get_av_packets(std::string filename, double timestamp, int seek_
     return web_packet_list;
 }
 
-int read_av_packet(std::string filename, double start, double end, int type, int wanted_stream_nb, int seek_flag, val js_caller)
+int is_mov_format(AVFormatContext *fmt_ctx)
+{
+    return strstr(fmt_ctx->iformat->name, "mp4") != NULL;
+}
+
+/**
+ * The mov demuxer builds the complete sample table (stts/ctts/stsz/stco) on open,
+ * so the index entries of a MP4/MOV stream are all its samples in decode order.
+ */
+WebSampleTable get_sample_table(std::string filename, int type, int wanted_stream_nb)
 {
     AVFormatContext *fmt_ctx = NULL;
     int ret;
 
-    if ((ret = avformat_open_input(&fmt_ctx, filename.c_str(), NULL, NULL)) < 0)
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
     {
         av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
         avformat_close_input(&fmt_ctx);
-        return 0;
+        throw std::runtime_error("Cannot open input file");
     }
 
-    if ((ret = avformat_find_stream_info(fmt_ctx, NULL)) < 0)
+    if (!is_mov_format(fmt_ctx))
     {
-        av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
         avformat_close_input(&fmt_ctx);
-        return 0;
+        throw std::runtime_error("Sample table is only available for MP4/MOV");
     }
 
     int stream_index = av_find_best_stream(fmt_ctx, (AVMediaType)type, wanted_stream_nb, -1, NULL, 0);
@@ -585,64 +1112,1403 @@ int read_av_packet(std::string filename, double start, double end, int type, int
     {
         av_log(NULL, AV_LOG_ERROR, "Cannot find wanted stream in the input file\n");
         avformat_close_input(&fmt_ctx);
-        return 0;
+        throw std::runtime_error("Cannot find wanted stream in the input file");
     }
 
-    AVPacket *packet = NULL;
-    packet = av_packet_alloc();
+    AVStream *stream = fmt_ctx->streams[stream_index];
+    int nb_entries = avformat_index_get_entries_count(stream);
+    double time_base = av_q2d(stream->time_base);
+    WebSampleTable sample_table;
 
-    if (!packet)
+    sample_table.stream_index = stream_index;
+    sample_table.timestamps.reserve(nb_entries);
+    sample_table.offsets.reserve(nb_entries);
+    sample_table.sizes.reserve(nb_entries);
+    sample_table.keyframes.reserve(nb_entries);
+
+    for (int i = 0; i < nb_entries; i++)
+    {
+        const AVIndexEntry *entry = avformat_index_get_entry(stream, i);
+
+        sample_table.timestamps.push_back(entry->timestamp * time_base);
+        sample_table.offsets.push_back((double)entry->pos);
+        sample_table.sizes.push_back(entry->size);
+        sample_table.keyframes.push_back(entry->flags & AVINDEX_KEYFRAME ? 1 : 0);
+    }
+
+    avformat_close_input(&fmt_ctx);
+
+    return sample_table;
+}
+
+/**
+ * Get a run of samples by index in the sample table.
+ * Other streams are discarded, so the mov demuxer reads each sample at its offset
+ * instead of the interleaved chunks of other tracks, and adjacent samples are
+ * read sequentially without seeking.
+ */
+WebAVPacketList get_samples(std::string filename, int stream_index, int first, int count)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    int ret;
+
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
+        avformat_close_input(&fmt_ctx);
+        throw std::runtime_error("Cannot open input file");
+    }
+
+    if (!is_mov_format(fmt_ctx))
+    {
+        avformat_close_input(&fmt_ctx);
+        throw std::runtime_error("Sample table is only available for MP4/MOV");
+    }
+
+    if (stream_index < 0 || stream_index >= (int)fmt_ctx->nb_streams)
+    {
+        avformat_close_input(&fmt_ctx);
+        throw std::runtime_error("Invalid stream index");
+    }
+
+    AVStream *stream = fmt_ctx->streams[stream_index];
+    int nb_entries = avformat_index_get_entries_count(stream);
+
+    if (first < 0 || first >= nb_entries)
+    {
+        avformat_close_input(&fmt_ctx);
+        throw std::runtime_error("Sample index out of range");
+    }
+
+    count = std::min(count, nb_entries - first);
+    discard_other_streams(fmt_ctx, stream_index);
+
+    // the timestamp of an index entry seeks exactly to its sample
+    const AVIndexEntry *entry = avformat_index_get_entry(stream, first);
+
+    if ((ret = av_seek_frame(fmt_ctx, stream_index, entry->timestamp, AVSEEK_FLAG_ANY)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot seek to the specified sample\n");
+        avformat_close_input(&fmt_ctx);
+        throw std::runtime_error("Cannot seek to the specified sample");
+    }
+
+    AVPacket *packet = av_packet_alloc();
+
+    if (!packet)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate packet\n");
+        avformat_close_input(&fmt_ctx);
+        throw std::runtime_error("Cannot allocate packet");
+    }
+
+    WebAVPacketList web_packet_list;
+
+    web_packet_list.packets.reserve(count);
+
+    while ((int)web_packet_list.packets.size() < count && av_read_frame(fmt_ctx, packet) >= 0)
+    {
+        if (packet->stream_index == stream_index)
+        {
+            web_packet_list.packets.emplace_back();
+            gen_web_packet(web_packet_list.packets.back(), packet, stream);
+        }
+        av_packet_unref(packet);
+    }
+
+    web_packet_list.size = web_packet_list.packets.size();
+
+    av_packet_free(&packet);
+    avformat_close_input(&fmt_ctx);
+
+    return web_packet_list;
+}
+
+#define DISCONTINUITY_THRESHOLD 1.0 // seconds of dts jump beyond the previous packet duration
+#define MAX_DISCONTINUITIES 100
+
+/**
+ * Run the read loop of one stream inside wasm and only return aggregated statistics,
+ * nothing is sent to js per packet. The read runs in slices between other requests.
+ */
+WebStreamAnalysis analyze_stream(std::string filename, double start, double end, int type, int wanted_stream_nb, double bitrate_bucket, val js_caller)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    int ret;
+
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
+        avformat_close_input(&fmt_ctx);
+        throw std::runtime_error("Cannot open input file");
+    }
+
+    if ((ret = avformat_find_stream_info(fmt_ctx, NULL)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
+        avformat_close_input(&fmt_ctx);
+        throw std::runtime_error("Cannot find stream information");
+    }
+
+    SeekPointRecorder seek_points = open_seek_index(filename, fmt_ctx);
+
+    int stream_index = av_find_best_stream(fmt_ctx, (AVMediaType)type, wanted_stream_nb, -1, NULL, 0);
+
+    if (stream_index < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find wanted stream in the input file\n");
+        avformat_close_input(&fmt_ctx);
+        throw std::runtime_error("Cannot find wanted stream in the input file");
+    }
+
+    AVStream *stream = fmt_ctx->streams[stream_index];
+    double time_base = av_q2d(stream->time_base);
+
+    discard_other_streams(fmt_ctx, stream_index);
+
+    if (start > 0)
+    {
+        int64_t start_timestamp = av_rescale_q((int64_t)(start * AV_TIME_BASE), AV_TIME_BASE_Q, stream->time_base);
+
+        if ((ret = seek_frame(fmt_ctx, seek_points, stream_index, start_timestamp, AVSEEK_FLAG_BACKWARD)) < 0)
+        {
+            av_log(NULL, AV_LOG_ERROR, "Cannot seek to the specified timestamp\n");
+            avformat_close_input(&fmt_ctx);
+            throw std::runtime_error("Cannot seek to the specified timestamp");
+        }
+    }
+
+    AVPacket *packet = av_packet_alloc();
+
+    if (!packet)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate packet\n");
+        avformat_close_input(&fmt_ctx);
+        throw std::runtime_error("Cannot allocate packet");
+    }
+
+    WebStreamAnalysis analysis = {};
+    std::map<int, int> gop_lengths;
+    int gop_length = 0;
+    double last_keyframe_time = -1;
+    int keyframe_intervals = 0;
+    double keyframe_interval_sum = 0;
+    int64_t last_dts = AV_NOPTS_VALUE;
+    int64_t last_duration = 0;
+    int64_t max_pts = AV_NOPTS_VALUE;
+
+    analysis.stream_index = stream_index;
+    analysis.bitrate_bucket = bitrate_bucket > 0 ? bitrate_bucket : 1;
+    analysis.start_time = -1;
+
+    while ((ret = av_read_frame(fmt_ctx, packet)) >= 0)
+    {
+        // give way to other requests once the slice is over, 0 when the source is closed
+        if (js_caller.call<int>("shouldYield") && js_caller.call<val>("nextSlice").await().as<int>() == 0)
+        {
+            av_packet_unref(packet);
+            break;
+        }
+
+        record_seek_point(seek_points, packet);
+
+        if (packet->stream_index != stream_index)
+        {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        int64_t pts = packet->pts;
+        int64_t dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : pts;
+        double time = (pts != AV_NOPTS_VALUE ? pts : dts) * time_base;
+
+        if (end > 0 && time > end)
+        {
+            av_packet_unref(packet);
+            break;
+        }
+
+        if (analysis.start_time < 0)
+        {
+            analysis.start_time = time;
+        }
+        analysis.end_time = std::max(analysis.end_time, time + packet->duration * time_base);
+
+        analysis.packet_count++;
+        analysis.total_size += packet->size;
+        analysis.max_packet_size = std::max(analysis.max_packet_size, packet->size);
+
+        // bitrate series
+        size_t bucket = (size_t)std::max(0.0, (time - analysis.start_time) / analysis.bitrate_bucket);
+
+        if (bucket >= analysis.bitrate_series.size())
+        {
+            analysis.bitrate_series.resize(bucket + 1, 0);
+        }
+        analysis.bitrate_series[bucket] += packet->size * 8 / analysis.bitrate_bucket;
+
+        // GOP structure, packets before the first keyframe belong to no GOP
+        if (packet->flags & AV_PKT_FLAG_KEY)
+        {
+            if (gop_length > 0)
+            {
+                gop_lengths[gop_length]++;
+            }
+            gop_length = 1;
+
+            if (last_keyframe_time >= 0)
+            {
+                double interval = time - last_keyframe_time;
+
+                analysis.min_keyframe_interval = keyframe_intervals ? std::min(analysis.min_keyframe_interval, interval) : interval;
+                analysis.max_keyframe_interval = std::max(analysis.max_keyframe_interval, interval);
+                keyframe_interval_sum += interval;
+                keyframe_intervals++;
+            }
+            last_keyframe_time = time;
+            analysis.keyframe_count++;
+        }
+        else if (gop_length > 0)
+        {
+            gop_length++;
+        }
+
+        // timestamp anomalies
+        if (pts == AV_NOPTS_VALUE)
+        {
+            analysis.missing_pts_count++;
+        }
+        else
+        {
+            if (packet->dts != AV_NOPTS_VALUE && pts < packet->dts)
+            {
+                analysis.pts_before_dts_count++;
+            }
+
+            // presentation order differs from decode order
+            if (max_pts != AV_NOPTS_VALUE && pts < max_pts)
+            {
+                analysis.has_b_frames = 1;
+            }
+            max_pts = max_pts == AV_NOPTS_VALUE ? pts : std::max(max_pts, pts);
+        }
+
+        if (dts != AV_NOPTS_VALUE && last_dts != AV_NOPTS_VALUE)
+        {
+            if (dts <= last_dts)
+            {
+                analysis.non_monotonic_dts_count++;
+            }
+            else if ((dts - last_dts - last_duration) * time_base > DISCONTINUITY_THRESHOLD &&
+                     analysis.discontinuities.size() < MAX_DISCONTINUITIES)
+            {
+                analysis.discontinuities.push_back(dts * time_base);
+            }
+        }
+
+        if (dts != AV_NOPTS_VALUE)
+        {
+            last_dts = dts;
+            last_duration = packet->duration;
+        }
+
+        av_packet_unref(packet);
+    }
+
+    if (gop_length > 0)
+    {
+        gop_lengths[gop_length]++;
+    }
+
+    for (const auto &gop : gop_lengths)
+    {
+        analysis.gop_histogram.push_back({gop.first, gop.second});
+    }
+
+    analysis.avg_keyframe_interval = keyframe_intervals ? keyframe_interval_sum / keyframe_intervals : 0;
+    analysis.start_time = std::max(analysis.start_time, 0.0);
+
+    if (stream->codecpar->video_delay > 0)
+    {
+        analysis.has_b_frames = 1;
+    }
+
+    end_seek_runs(seek_points, ret == AVERROR_EOF);
+    av_packet_free(&packet);
+    avformat_close_input(&fmt_ctx);
+
+    return analysis;
+}
+
+/**
+ * Send a packet to js, returns 0 when reading should stop.
+ * Only suspends when the read-ahead queue on the main thread is full.
+ */
+int send_av_packet(val &js_caller, WebAVPacket &web_packet)
+{
+    int send_result = js_caller.call<int>("sendAVPacket", web_packet);
+
+    if (send_result < 0)
+    {
+        send_result = js_caller.call<val>("waitAVPacketCredit").await().as<int>();
+    }
+
+    return send_result;
+}
+
+int read_av_packet(std::string filename, double start, double end, int type, int wanted_stream_nb, int seek_flag, val js_caller)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    int ret;
+
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    if ((ret = avformat_find_stream_info(fmt_ctx, NULL)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    SeekPointRecorder seek_points = open_seek_index(filename, fmt_ctx);
+
+    int stream_index = av_find_best_stream(fmt_ctx, (AVMediaType)type, wanted_stream_nb, -1, NULL, 0);
+
+    if (stream_index < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find wanted stream in the input file\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    discard_other_streams(fmt_ctx, stream_index);
+
+    AVPacket *packet = NULL;
+    packet = av_packet_alloc();
+
+    if (!packet)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate packet\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    if (start > 0)
+    {
+        int64_t start_timestamp = (int64_t)(start * AV_TIME_BASE);
+        int64_t rescaled_start_time_stamp = av_rescale_q(start_timestamp, AV_TIME_BASE_Q, fmt_ctx->streams[stream_index]->time_base);
+
+        if ((ret = seek_frame(fmt_ctx, seek_points, stream_index, rescaled_start_time_stamp, seek_flag)) < 0)
+        {
+            av_log(NULL, AV_LOG_ERROR, "Cannot seek to the specified timestamp\n");
+            avformat_close_input(&fmt_ctx);
+            av_packet_unref(packet);
+            av_packet_free(&packet);
+            return 0;
+        }
+    }
+
+    while ((ret = av_read_frame(fmt_ctx, packet)) >= 0)
+    {
+        record_seek_point(seek_points, packet);
+
+        if (packet->stream_index == stream_index)
+        {
+            WebAVPacket web_packet;
+
+            gen_web_packet(web_packet, packet, fmt_ctx->streams[stream_index]);
+
+            if (end > 0 && web_packet.timestamp > end)
+            {
+                break;
+            }
+
+            // call js method to send packet
+            if (send_av_packet(js_caller, web_packet) == 0)
+            {
+                break;
+            }
+        }
+        av_packet_unref(packet);
+    }
+
+    // call js method to end send packet
+    js_caller.call<void>("sendAVPacket", 0);
+    end_seek_runs(seek_points, ret == AVERROR_EOF);
+
+    avformat_close_input(&fmt_ctx);
+    av_packet_unref(packet);
+    av_packet_free(&packet);
+
+    return 1;
+}
+
+#define PLAYBACK_NO_STREAM -2
+
+/**
+ * Start playback from a single open: the selected streams and the first keyframe of
+ * the lead stream (video if selected, else audio) at start are sent by sendPlaybackStart,
+ * then the packets of the selected streams that follow it, in file order, by sendAVPacket.
+ * wanted_video_nb / wanted_audio_nb are -1 for the best stream, PLAYBACK_NO_STREAM to leave it out.
+ */
+int start_playback(std::string filename, double start, double end, int wanted_video_nb, int wanted_audio_nb, val js_caller)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    int ret;
+
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    if ((ret = avformat_find_stream_info(fmt_ctx, NULL)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    SeekPointRecorder seek_points = open_seek_index(filename, fmt_ctx);
+
+    int video_index = wanted_video_nb == PLAYBACK_NO_STREAM
+        ? -1
+        : av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, wanted_video_nb, -1, NULL, 0);
+    int audio_index = wanted_audio_nb == PLAYBACK_NO_STREAM
+        ? -1
+        : av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, wanted_audio_nb, video_index, NULL, 0);
+    int lead_index = video_index >= 0 ? video_index : audio_index;
+
+    if (lead_index < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find wanted stream in the input file\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++)
+    {
+        if ((int)i != video_index && (int)i != audio_index)
+        {
+            fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    AVPacket *packet = av_packet_alloc();
+
+    if (!packet)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate packet\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    if (start > 0)
+    {
+        int64_t start_timestamp = (int64_t)(start * AV_TIME_BASE);
+        int64_t rescaled_start_time_stamp = av_rescale_q(start_timestamp, AV_TIME_BASE_Q, fmt_ctx->streams[lead_index]->time_base);
+
+        if ((ret = seek_frame(fmt_ctx, seek_points, lead_index, rescaled_start_time_stamp, AVSEEK_FLAG_BACKWARD)) < 0)
+        {
+            av_log(NULL, AV_LOG_ERROR, "Cannot seek to the specified timestamp\n");
+            avformat_close_input(&fmt_ctx);
+            av_packet_free(&packet);
+            return 0;
+        }
+    }
+
+    WebAVStreamList stream_list = {
+        .size = 0,
+        .streams = std::vector<WebAVStream>(),
+    };
+
+    for (int stream_index : {video_index, audio_index})
+    {
+        if (stream_index >= 0)
+        {
+            stream_list.streams.emplace_back();
+            gen_web_stream(stream_list.streams.back(), fmt_ctx->streams[stream_index], fmt_ctx);
+            stream_list.size++;
+        }
+    }
+
+    // packets of the other stream demuxed before the first keyframe, sent right after it
+    std::vector<WebAVPacket> pending_packets;
+    WebAVPacket first_packet;
+    int found = 0;
+
+    while (av_read_frame(fmt_ctx, packet) >= 0)
+    {
+        record_seek_point(seek_points, packet);
+
+        if (packet->stream_index == lead_index && (packet->flags & AV_PKT_FLAG_KEY))
+        {
+            gen_web_packet(first_packet, packet, fmt_ctx->streams[lead_index]);
+            found = 1;
+            av_packet_unref(packet);
+            break;
+        }
+
+        // delta frames of the lead stream before its first keyframe cannot be decoded
+        if (packet->stream_index != lead_index)
+        {
+            pending_packets.emplace_back();
+            gen_web_packet(pending_packets.back(), packet, fmt_ctx->streams[packet->stream_index]);
+        }
+        av_packet_unref(packet);
+    }
+
+    if (!found)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Failed to get a keyframe at the start time\n");
+        avformat_close_input(&fmt_ctx);
+        av_packet_free(&packet);
+        return 0;
+    }
+
+    js_caller.call<void>("sendPlaybackStart", stream_list, first_packet);
+
+    int stopped = 0;
+
+    for (WebAVPacket &web_packet : pending_packets)
+    {
+        if (send_av_packet(js_caller, web_packet) == 0)
+        {
+            stopped = 1;
+            break;
+        }
+    }
+
+    while (!stopped && (ret = av_read_frame(fmt_ctx, packet)) >= 0)
+    {
+        record_seek_point(seek_points, packet);
+
+        if (packet->stream_index == video_index || packet->stream_index == audio_index)
+        {
+            WebAVPacket web_packet;
+
+            gen_web_packet(web_packet, packet, fmt_ctx->streams[packet->stream_index]);
+
+            if (end > 0 && web_packet.timestamp > end)
+            {
+                break;
+            }
+
+            if (send_av_packet(js_caller, web_packet) == 0)
+            {
+                stopped = 1;
+            }
+        }
+        av_packet_unref(packet);
+    }
+
+    // call js method to end send packet
+    js_caller.call<void>("sendAVPacket", 0);
+    end_seek_runs(seek_points, !stopped && ret == AVERROR_EOF);
+
+    avformat_close_input(&fmt_ctx);
+    av_packet_unref(packet);
+    av_packet_free(&packet);
+
+    return 1;
+}
+
+/**
+ * Read only the keyframes of a stream, for trick play and thumbnail scrubbing.
+ * With a seek index, the reader jumps from keyframe entry to keyframe entry, so the bytes
+ * of delta frames are never read. Without one, packets are read in order and delta frames
+ * are dropped in wasm.
+ * every keeps every Nth keyframe, min_interval keeps keyframes at least that many seconds apart.
+ */
+int read_keyframe_packet(std::string filename, double start, double end, int type, int wanted_stream_nb, int every, double min_interval, val js_caller)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    int ret;
+
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    if ((ret = avformat_find_stream_info(fmt_ctx, NULL)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    SeekPointRecorder seek_points = open_seek_index(filename, fmt_ctx);
+
+    int stream_index = av_find_best_stream(fmt_ctx, (AVMediaType)type, wanted_stream_nb, -1, NULL, 0);
+
+    if (stream_index < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find wanted stream in the input file\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    discard_other_streams(fmt_ctx, stream_index);
+
+    AVPacket *packet = av_packet_alloc();
+
+    if (!packet)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate packet\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    AVStream *stream = fmt_ctx->streams[stream_index];
+    double time_base = av_q2d(stream->time_base);
+    int64_t start_timestamp = start > 0 ? (int64_t)(start / time_base) : INT64_MIN;
+
+    every = std::max(every, 1);
+
+    // also rewinds after find_stream_info, and matroska parses cues stored after the clusters on the first seek
+    if ((ret = seek_frame(fmt_ctx, seek_points, stream_index, start > 0 ? start_timestamp : 0, AVSEEK_FLAG_BACKWARD)) < 0 && start > 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot seek to the specified timestamp\n");
+        av_packet_free(&packet);
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    int keyframe_count = 0;
+
+    // recorded seek points may miss keyframes, only the index of the demuxer is walked
+    if (!seek_points.streams && has_seek_index(fmt_ctx, stream))
+    {
+        int64_t next_timestamp = start_timestamp;
+        int64_t last_dts = AV_NOPTS_VALUE;
+
+        while (true)
+        {
+            // the first keyframe entry at or after next_timestamp, entries may move while reading
+            const AVIndexEntry *entry = avformat_index_get_entry_from_timestamp(stream, next_timestamp, 0);
+
+            if (!entry)
+            {
+                break;
+            }
+
+            int64_t timestamp = entry->timestamp;
+
+            if (end > 0 && timestamp * time_base > end)
+            {
+                break;
+            }
+
+            next_timestamp = timestamp + 1;
+
+            if (keyframe_count++ % every != 0)
+            {
+                continue;
+            }
+
+            if (min_interval > 0)
+            {
+                next_timestamp = std::max(next_timestamp, timestamp + (int64_t)(min_interval / time_base));
+            }
+
+            if (seek_frame(fmt_ctx, seek_points, stream_index, timestamp, AVSEEK_FLAG_BACKWARD) < 0)
+            {
+                break;
+            }
+
+            int sent = 1;
+
+            while ((ret = av_read_frame(fmt_ctx, packet)) >= 0)
+            {
+                if (packet->stream_index != stream_index || !(packet->flags & AV_PKT_FLAG_KEY))
+                {
+                    av_packet_unref(packet);
+                    continue;
+                }
+
+                // an entry whose seek landed on the keyframe already sent
+                if (last_dts == AV_NOPTS_VALUE || packet->dts == AV_NOPTS_VALUE || packet->dts > last_dts)
+                {
+                    WebAVPacket web_packet;
+
+                    last_dts = packet->dts;
+                    gen_web_packet(web_packet, packet, stream);
+                    sent = send_av_packet(js_caller, web_packet);
+                }
+
+                av_packet_unref(packet);
+                break;
+            }
+
+            if (ret < 0 || sent == 0)
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        double last_time = 0;
+        int has_last = 0;
+
+        while ((ret = av_read_frame(fmt_ctx, packet)) >= 0)
+        {
+            record_seek_point(seek_points, packet);
+
+            if (packet->stream_index == stream_index && packet->flags & AV_PKT_FLAG_KEY)
+            {
+                WebAVPacket web_packet;
+
+                gen_web_packet(web_packet, packet, stream);
+
+                if (end > 0 && web_packet.timestamp > end)
+                {
+                    break;
+                }
+
+                if (keyframe_count++ % every == 0 &&
+                    (min_interval <= 0 || !has_last || web_packet.timestamp - last_time >= min_interval))
+                {
+                    last_time = web_packet.timestamp;
+                    has_last = 1;
+
+                    if (send_av_packet(js_caller, web_packet) == 0)
+                    {
+                        break;
+                    }
+                }
+            }
+            av_packet_unref(packet);
+        }
+    }
+
+    // call js method to end send packet
+    js_caller.call<void>("sendAVPacket", 0);
+    end_seek_runs(seek_points, ret == AVERROR_EOF);
+
+    av_packet_unref(packet);
+    av_packet_free(&packet);
+    avformat_close_input(&fmt_ctx);
+
+    return 1;
+}
+
+/**
+ * Send a GOP to js, returns 0 when reading should stop.
+ */
+int send_gop(val &js_caller, WebAVPacketList &gop)
+{
+    int send_result = js_caller.call<int>("sendGOP", gop);
+
+    if (send_result < 0)
+    {
+        send_result = js_caller.call<val>("waitGOPCredit").await().as<int>();
+    }
+
+    return send_result;
+}
+
+#define MAX_GOP_SEEK_RETRIES 8
+
+/**
+ * Walk the GOPs of a stream backwards, from the GOP containing start towards end (end < start),
+ * for reverse playback. Each GOP is sent as one batch of packets in decode order starting at its
+ * keyframe, so it can be decoded and presented reversed. A GOP is read with one seek to its
+ * keyframe and up to the keyframe of the GOP sent before it, so each byte is read once.
+ */
+int read_reverse_gop(std::string filename, double start, double end, int type, int wanted_stream_nb, val js_caller)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    int ret;
+
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    if ((ret = avformat_find_stream_info(fmt_ctx, NULL)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    SeekPointRecorder seek_points = open_seek_index(filename, fmt_ctx);
+
+    int stream_index = av_find_best_stream(fmt_ctx, (AVMediaType)type, wanted_stream_nb, -1, NULL, 0);
+
+    if (stream_index < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find wanted stream in the input file\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    discard_other_streams(fmt_ctx, stream_index);
+
+    AVStream *stream = fmt_ctx->streams[stream_index];
+    double time_base = av_q2d(stream->time_base);
+    int64_t start_timestamp = INT64_MAX;
+    int64_t end_timestamp = end > 0 ? (int64_t)(end / time_base) : INT64_MIN;
+
+    if (start > 0)
+    {
+        start_timestamp = (int64_t)(start / time_base);
+    }
+    else if (fmt_ctx->duration != AV_NOPTS_VALUE)
+    {
+        // from the end of the file
+        int64_t start_time = fmt_ctx->start_time != AV_NOPTS_VALUE ? fmt_ctx->start_time : 0;
+
+        start_timestamp = av_rescale_q(start_time + fmt_ctx->duration, AV_TIME_BASE_Q, stream->time_base);
+    }
+    else
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot read backwards from the end without a duration\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+
+    if (!packet)
     {
         av_log(NULL, AV_LOG_ERROR, "Cannot allocate packet\n");
         avformat_close_input(&fmt_ctx);
         return 0;
     }
 
-    if (start > 0)
+    // the first keyframe of the GOP sent last, unknown before the first GOP
+    int64_t boundary = INT64_MAX;
+    int64_t target = start_timestamp;
+    // how far to step back when a seek without index lands on the GOP sent last
+    int64_t step = (int64_t)(1 / time_base);
+    int retries = 0;
+
+    while (true)
+    {
+        int indexed = !seek_points.streams && has_seek_index(fmt_ctx, stream);
+
+        if (indexed)
+        {
+            const AVIndexEntry *entry = avformat_index_get_entry_from_timestamp(stream, target, AVSEEK_FLAG_BACKWARD);
+
+            if (!entry)
+            {
+                break;
+            }
+
+            target = entry->timestamp;
+        }
+
+        if (seek_frame(fmt_ctx, seek_points, stream_index, target, AVSEEK_FLAG_BACKWARD) < 0)
+        {
+            break;
+        }
+
+        WebAVPacketList gop;
+        int64_t gop_dts = AV_NOPTS_VALUE;
+
+        while ((ret = av_read_frame(fmt_ctx, packet)) >= 0)
+        {
+            record_seek_point(seek_points, packet);
+
+            if (packet->stream_index != stream_index)
+            {
+                av_packet_unref(packet);
+                continue;
+            }
+
+            int64_t dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+            int keyframe = packet->flags & AV_PKT_FLAG_KEY;
+
+            if (gop.packets.empty() && !keyframe && dts < boundary)
+            {
+                // a seek without index may land before the keyframe
+                av_packet_unref(packet);
+                continue;
+            }
+
+            // the first GOP ends at the first keyframe after start
+            if (dts >= boundary ||
+                (boundary == INT64_MAX && keyframe && !gop.packets.empty() && dts > start_timestamp))
+            {
+                av_packet_unref(packet);
+                break;
+            }
+
+            if (gop.packets.empty())
+            {
+                gop_dts = dts;
+            }
+
+            gop.packets.emplace_back();
+            gen_web_packet(gop.packets.back(), packet, stream);
+            av_packet_unref(packet);
+        }
+
+        if (gop.packets.empty())
+        {
+            // the seek landed on the GOP sent last, step further back
+            if (indexed || ++retries > MAX_GOP_SEEK_RETRIES)
+            {
+                break;
+            }
+
+            target -= step;
+            step *= 2;
+            continue;
+        }
+
+        retries = 0;
+        step = (int64_t)(1 / time_base);
+        gop.size = gop.packets.size();
+
+        if (send_gop(js_caller, gop) == 0 || gop_dts <= end_timestamp)
+        {
+            break;
+        }
+
+        boundary = gop_dts;
+        target = gop_dts - 1;
+    }
+
+    // call js method to end send gop
+    js_caller.call<void>("sendGOP", 0);
+    end_seek_runs(seek_points, false);
+
+    av_packet_free(&packet);
+    avformat_close_input(&fmt_ctx);
+
+    return 1;
+}
+
+#define EXPORT_IO_BUFFER_SIZE 65536
+
+// the write callback takes a const buffer since libavformat 61
+#if !defined(FF_API_AVIO_WRITE_NONCONST) || FF_API_AVIO_WRITE_NONCONST
+static int write_export_data(void *opaque, uint8_t *buf, int buf_size)
+#else
+static int write_export_data(void *opaque, const uint8_t *buf, int buf_size)
+#endif
+{
+    val *js_caller = (val *)opaque;
+    int write_result = js_caller->call<int>("writeChunk", (uintptr_t)buf, buf_size);
+
+    // the chunk is copied already, wait until the consumer catches up
+    if (write_result < 0)
+    {
+        write_result = js_caller->call<val>("waitChunkCredit").await().as<int>();
+    }
+
+    return write_result == 0 ? AVERROR_EXIT : buf_size;
+}
+
+/**
+ * Stream copy [start, end] of the selected streams into a new container, without decoding.
+ * The clip starts at the keyframe at or before start of the first selected video stream
+ * (or the first selected stream), timestamps are shifted to start at 0.
+ * The output is non-seekable and written to js in chunks, so mp4/mov are fragmented.
+ */
+int export_clip(std::string filename, std::string format_name, double start, double end, val js_stream_indices, val js_caller)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    AVFormatContext *out_ctx = NULL;
+    AVIOContext *avio_ctx = NULL;
+    uint8_t *avio_buffer = NULL;
+    AVPacket *packet = NULL;
+    AVDictionary *mux_opts = NULL;
+    int io_buffer_size = budget_io_buffer_size(EXPORT_IO_BUFFER_SIZE);
+    int ret;
+    int result = 0;
+
+    if ((ret = open_input(&fmt_ctx, filename.c_str())) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
+        return 0;
+    }
+
+    if ((ret = avformat_find_stream_info(fmt_ctx, NULL)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    SeekPointRecorder seek_points = open_seek_index(filename, fmt_ctx);
+
+    std::vector<int> stream_indices = vecFromJSArray<int>(js_stream_indices);
+
+    // default to the best video and audio streams
+    if (stream_indices.empty())
     {
-        int64_t start_timestamp = (int64_t)(start * AV_TIME_BASE);
-        int64_t rescaled_start_time_stamp = av_rescale_q(start_timestamp, AV_TIME_BASE_Q, fmt_ctx->streams[stream_index]->time_base);
+        int video_index = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+        int audio_index = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
 
-        if ((ret = av_seek_frame(fmt_ctx, stream_index, rescaled_start_time_stamp, seek_flag)) < 0)
+        if (video_index >= 0)
         {
-            av_log(NULL, AV_LOG_ERROR, "Cannot seek to the specified timestamp\n");
+            stream_indices.push_back(video_index);
+        }
+        if (audio_index >= 0)
+        {
+            stream_indices.push_back(audio_index);
+        }
+    }
+
+    std::vector<int> output_index(fmt_ctx->nb_streams, -1);
+    int ref_stream_index = -1;
+
+    for (int stream_index : stream_indices)
+    {
+        if (stream_index < 0 || stream_index >= (int)fmt_ctx->nb_streams || output_index[stream_index] >= 0)
+        {
+            av_log(NULL, AV_LOG_ERROR, "Invalid stream index %d\n", stream_index);
             avformat_close_input(&fmt_ctx);
-            av_packet_unref(packet);
-            av_packet_free(&packet);
             return 0;
         }
+
+        output_index[stream_index] = 0;
+
+        if (ref_stream_index < 0 || (fmt_ctx->streams[ref_stream_index]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+                                     fmt_ctx->streams[stream_index]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO))
+        {
+            ref_stream_index = stream_index;
+        }
     }
 
-    while (av_read_frame(fmt_ctx, packet) >= 0)
+    if (ref_stream_index < 0)
     {
-        if (packet->stream_index == stream_index)
+        av_log(NULL, AV_LOG_ERROR, "Cannot find streams to export\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
+
+    // only the bytes of the selected streams are read
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++)
+    {
+        if (output_index[i] < 0)
         {
-            WebAVPacket web_packet;
+            fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
 
-            gen_web_packet(web_packet, packet, fmt_ctx->streams[stream_index]);
+    if ((ret = avformat_alloc_output_context2(&out_ctx, NULL, format_name.c_str(), NULL)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find output format\n");
+        avformat_close_input(&fmt_ctx);
+        return 0;
+    }
 
-            if (end > 0 && web_packet.timestamp > end)
+    for (int stream_index : stream_indices)
+    {
+        AVStream *in_stream = fmt_ctx->streams[stream_index];
+        AVStream *out_stream = avformat_new_stream(out_ctx, NULL);
+
+        if (!out_stream || avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar) < 0)
+        {
+            av_log(NULL, AV_LOG_ERROR, "Cannot create output stream\n");
+            goto end;
+        }
+
+        // let the muxer pick the tag of the output container
+        out_stream->codecpar->codec_tag = 0;
+        out_stream->time_base = in_stream->time_base;
+        output_index[stream_index] = out_stream->index;
+    }
+
+    avio_buffer = (uint8_t *)av_malloc(io_buffer_size);
+    avio_ctx = avio_buffer ? avio_alloc_context(avio_buffer, io_buffer_size, 1, &js_caller, NULL, &write_export_data, NULL) : NULL;
+
+    if (!avio_ctx)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate io context\n");
+        av_free(avio_buffer);
+        goto end;
+    }
+
+    out_ctx->pb = avio_ctx;
+
+    if (av_match_name(out_ctx->oformat->name, "mp4,mov,ipod,ismv"))
+    {
+        av_dict_set(&mux_opts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    }
+
+    ret = avformat_write_header(out_ctx, &mux_opts);
+    av_dict_free(&mux_opts);
+
+    if (ret < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot write output header\n");
+        goto end;
+    }
+
+    if (start > 0)
+    {
+        int64_t start_timestamp = av_rescale_q((int64_t)(start * AV_TIME_BASE), AV_TIME_BASE_Q, fmt_ctx->streams[ref_stream_index]->time_base);
+
+        if ((ret = seek_frame(fmt_ctx, seek_points, ref_stream_index, start_timestamp, AVSEEK_FLAG_BACKWARD)) < 0)
+        {
+            av_log(NULL, AV_LOG_ERROR, "Cannot seek to the specified timestamp\n");
+            goto end;
+        }
+    }
+
+    if (!(packet = av_packet_alloc()))
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate packet\n");
+        goto end;
+    }
+
+    {
+        int64_t end_timestamp = end > 0 ? (int64_t)(end * AV_TIME_BASE) : INT64_MAX;
+        int64_t clip_start = AV_NOPTS_VALUE; // dts of the first keyframe of the reference stream
+        int finished_count = 0;
+        std::vector<bool> finished(fmt_ctx->nb_streams, false);
+
+        result = 1;
+
+        while (av_read_frame(fmt_ctx, packet) >= 0)
+        {
+            int stream_index = packet->stream_index;
+
+            record_seek_point(seek_points, packet);
+
+            if (output_index[stream_index] < 0 || finished[stream_index])
             {
-                break;
+                av_packet_unref(packet);
+                continue;
             }
 
-            // call js method to send packet
-            val result = js_caller.call<val>("sendAVPacket", web_packet).await();
-            int send_result = result.as<int>();
+            AVStream *in_stream = fmt_ctx->streams[stream_index];
+            AVStream *out_stream = out_ctx->streams[output_index[stream_index]];
+            int64_t packet_ts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            int64_t packet_time = packet_ts == AV_NOPTS_VALUE ? 0 : av_rescale_q(packet_ts, in_stream->time_base, AV_TIME_BASE_Q);
+            int64_t packet_dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet_ts;
+            int64_t decode_time = packet_dts == AV_NOPTS_VALUE ? 0 : av_rescale_q(packet_dts, in_stream->time_base, AV_TIME_BASE_Q);
+
+            // drop everything before the first keyframe of the reference stream
+            if (clip_start == AV_NOPTS_VALUE)
+            {
+                if (stream_index != ref_stream_index || !(packet->flags & AV_PKT_FLAG_KEY))
+                {
+                    av_packet_unref(packet);
+                    continue;
+                }
+
+                clip_start = av_rescale_q(packet->dts != AV_NOPTS_VALUE ? packet->dts : packet_ts, in_stream->time_base, AV_TIME_BASE_Q);
+            }
+
+            if (packet_time < clip_start)
+            {
+                av_packet_unref(packet);
+                continue;
+            }
+
+            // cut in decode order, packets after end in presentation order may still come
+            // later in decode order with B-frames
+            if (decode_time > end_timestamp)
+            {
+                finished[stream_index] = true;
+                av_packet_unref(packet);
+
+                if (++finished_count == (int)stream_indices.size())
+                {
+                    break;
+                }
+                continue;
+            }
+
+            int64_t offset = av_rescale_q(clip_start, AV_TIME_BASE_Q, in_stream->time_base);
 
-            if (send_result == 0)
+            if (packet->pts != AV_NOPTS_VALUE)
             {
+                packet->pts -= offset;
+            }
+            if (packet->dts != AV_NOPTS_VALUE)
+            {
+                packet->dts -= offset;
+            }
+
+            av_packet_rescale_ts(packet, in_stream->time_base, out_stream->time_base);
+            packet->stream_index = out_stream->index;
+            packet->pos = -1;
+
+            ret = av_interleaved_write_frame(out_ctx, packet);
+
+            // a muxer may buffer the write error of a stopped consumer
+            if (ret >= 0 && avio_ctx->error == AVERROR_EXIT)
+            {
+                ret = AVERROR_EXIT;
+            }
+
+            // takes the packet reference, fails when the consumer stopped
+            if (ret < 0)
+            {
+                if (ret != AVERROR_EXIT)
+                {
+                    av_log(NULL, AV_LOG_ERROR, "Cannot write packet\n");
+                    result = 0;
+                }
                 break;
             }
         }
+
+        if (result && ret != AVERROR_EXIT && (ret = av_write_trailer(out_ctx)) < 0 && ret != AVERROR_EXIT)
+        {
+            av_log(NULL, AV_LOG_ERROR, "Cannot write output trailer\n");
+            result = 0;
+        }
+    }
+
+end:
+    // end of the chunk stream, errors are thrown by js instead
+    if (result)
+    {
+        js_caller.call<void>("writeChunk", 0, 0);
+    }
+
+    if (avio_ctx)
+    {
+        av_freep(&avio_ctx->buffer);
+        avio_context_free(&avio_ctx);
+    }
+    avformat_free_context(out_ctx);
+    end_seek_runs(seek_points, false);
+    avformat_close_input(&fmt_ctx);
+    av_packet_free(&packet);
+
+    return result;
+}
+
+#define SEGMENT_IO_BUFFER_SIZE 32768
+
+static int read_segment_data(void *opaque, uint8_t *buf, int buf_size)
+{
+    val *js_caller = (val *)opaque;
+    int size = js_caller->call<int>("readSegmentData", (uintptr_t)buf, buf_size);
+
+    // no buffered segment data, wait for the next appended segment
+    while (size < 0)
+    {
+        js_caller->call<val>("waitSegmentData").await();
+        size = js_caller->call<int>("readSegmentData", (uintptr_t)buf, buf_size);
+    }
+
+    return size == 0 ? AVERROR_EOF : size;
+}
+
+int read_segment_packet(std::string format_name, val js_caller)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    AVIOContext *avio_ctx = NULL;
+    uint8_t *avio_buffer = NULL;
+    int ret;
+
+    // the input format is known upfront, so skip probing entirely
+    const AVInputFormat *input_format = av_find_input_format(format_name.c_str());
+
+    if (!input_format)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find input format\n");
+        return 0;
+    }
+
+    if (!(fmt_ctx = avformat_alloc_context()))
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate format context\n");
+        return 0;
+    }
+
+    int io_buffer_size = budget_io_buffer_size(SEGMENT_IO_BUFFER_SIZE);
+
+    avio_buffer = (uint8_t *)av_malloc(io_buffer_size);
+    avio_ctx = avio_buffer ? avio_alloc_context(avio_buffer, io_buffer_size, 0, &js_caller, &read_segment_data, NULL, NULL) : NULL;
+
+    if (!avio_ctx)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate io context\n");
+        av_free(avio_buffer);
+        avformat_free_context(fmt_ctx);
+        return 0;
+    }
+
+    fmt_ctx->pb = avio_ctx;
+    fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    if ((ret = open_input(&fmt_ctx, NULL, input_format)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open input segment\n");
+        av_freep(&avio_ctx->buffer);
+        avio_context_free(&avio_ctx);
+        return 0;
+    }
+
+    if ((ret = avformat_find_stream_info(fmt_ctx, NULL)) < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
+        avformat_close_input(&fmt_ctx);
+        av_freep(&avio_ctx->buffer);
+        avio_context_free(&avio_ctx);
+        return 0;
+    }
+
+    int num_streams = fmt_ctx->nb_streams;
+    WebAVStreamList stream_list = {
+        .size = num_streams,
+        .streams = std::vector<WebAVStream>(num_streams),
+    };
+
+    for (int stream_index = 0; stream_index < num_streams; stream_index++)
+    {
+        gen_web_stream(stream_list.streams[stream_index], fmt_ctx->streams[stream_index], fmt_ctx);
+    }
+
+    js_caller.call<void>("sendAVStreams", stream_list);
+
+    AVPacket *packet = av_packet_alloc();
+
+    if (!packet)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate packet\n");
+        avformat_close_input(&fmt_ctx);
+        av_freep(&avio_ctx->buffer);
+        avio_context_free(&avio_ctx);
+        return 0;
+    }
+
+    // the context lives across segments, so PAT/PMT, codec parameters and
+    // timestamp wrap state carry over from one segment to the next
+    while (av_read_frame(fmt_ctx, packet) >= 0)
+    {
+        WebAVPacket web_packet;
+
+        gen_web_packet(web_packet, packet, fmt_ctx->streams[packet->stream_index]);
+
+        int send_result = send_av_packet(js_caller, web_packet);
+
         av_packet_unref(packet);
+
+        if (send_result == 0)
+        {
+            break;
+        }
     }
 
-    // call js method to end send packet
-    js_caller.call<val>("sendAVPacket", 0).await();
+    js_caller.call<void>("sendAVPacket", 0);
 
     avformat_close_input(&fmt_ctx);
-    av_packet_unref(packet);
+    av_freep(&avio_ctx->buffer);
+    avio_context_free(&avio_ctx);
     av_packet_free(&packet);
 
     return 1;
@@ -708,6 +2574,7 @@ EMSCRIPTEN_BINDINGS(web_demuxer)
 
     class_<WebAVPacket>("WebAVPacket")
         .constructor<>()
+        .property("stream_index", &WebAVPacket::stream_index)
         .property("keyframe", &WebAVPacket::keyframe)
         .property("timestamp", &WebAVPacket::timestamp)
         .property("duration", &WebAVPacket::duration)
@@ -718,16 +2585,63 @@ EMSCRIPTEN_BINDINGS(web_demuxer)
         .field("size", &WebAVPacketList::size)
         .field("packets", &WebAVPacketList::packets);
 
+    value_object<WebGOPLengthCount>("WebGOPLengthCount")
+        .field("length", &WebGOPLengthCount::length)
+        .field("count", &WebGOPLengthCount::count);
+
+    value_object<WebStreamAnalysis>("WebStreamAnalysis")
+        .field("stream_index", &WebStreamAnalysis::stream_index)
+        .field("packet_count", &WebStreamAnalysis::packet_count)
+        .field("keyframe_count", &WebStreamAnalysis::keyframe_count)
+        .field("total_size", &WebStreamAnalysis::total_size)
+        .field("max_packet_size", &WebStreamAnalysis::max_packet_size)
+        .field("start_time", &WebStreamAnalysis::start_time)
+        .field("end_time", &WebStreamAnalysis::end_time)
+        .field("gop_histogram", &WebStreamAnalysis::gop_histogram)
+        .field("min_keyframe_interval", &WebStreamAnalysis::min_keyframe_interval)
+        .field("max_keyframe_interval", &WebStreamAnalysis::max_keyframe_interval)
+        .field("avg_keyframe_interval", &WebStreamAnalysis::avg_keyframe_interval)
+        .field("bitrate_bucket", &WebStreamAnalysis::bitrate_bucket)
+        .field("bitrate_series", &WebStreamAnalysis::bitrate_series)
+        .field("has_b_frames", &WebStreamAnalysis::has_b_frames)
+        .field("missing_pts_count", &WebStreamAnalysis::missing_pts_count)
+        .field("non_monotonic_dts_count", &WebStreamAnalysis::non_monotonic_dts_count)
+        .field("pts_before_dts_count", &WebStreamAnalysis::pts_before_dts_count)
+        .field("discontinuities", &WebStreamAnalysis::discontinuities);
+
+    class_<WebSampleTable>("WebSampleTable")
+        .constructor<>()
+        .property("stream_index", &WebSampleTable::stream_index)
+        .property("timestamps", &WebSampleTable::get_timestamps)
+        .property("offsets", &WebSampleTable::get_offsets)
+        .property("sizes", &WebSampleTable::get_sizes)
+        .property("keyframes", &WebSampleTable::get_keyframes);
+
     function("get_av_stream", &get_av_stream, return_value_policy::take_ownership());
     function("get_av_streams", &get_av_streams, return_value_policy::take_ownership());
     function("get_media_info", &get_media_info, return_value_policy::take_ownership());
     function("get_av_packet", &get_av_packet, return_value_policy::take_ownership());
     function("get_av_packets", &get_av_packets, return_value_policy::take_ownership());
+    function("get_sample_table", &get_sample_table, return_value_policy::take_ownership());
+    function("get_samples", &get_samples, return_value_policy::take_ownership());
+    function("analyze_stream", &analyze_stream, return_value_policy::take_ownership());
     function("read_av_packet", &read_av_packet);
+    function("start_playback", &start_playback);
+    function("read_keyframe_packet", &read_keyframe_packet);
+    function("read_reverse_gop", &read_reverse_gop);
+    function("read_segment_packet", &read_segment_packet);
+    function("build_seek_index", &build_seek_index);
+    function("clear_seek_index", &clear_seek_index);
+    function("export_clip", &export_clip);
     function("set_av_log_level", &set_av_log_level);
+    function("set_memory_budget", &set_memory_budget);
+    function("get_heap_used", &get_heap_used);
+    function("get_heap_fragmentation", &get_heap_fragmentation);
 
     register_vector<uint8_t>("vector<uint8_t>");
     register_vector<Tag>("vector<Tag>");
     register_vector<WebAVStream>("vector<WebAVStream>");
     register_vector<WebAVPacket>("vector<WebAVPacket>");
+    register_vector<WebGOPLengthCount>("vector<WebGOPLengthCount>");
+    register_vector<double>("vector<double>");
 }
\ No newline at end of file
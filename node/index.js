@@ -0,0 +1,157 @@
+/**
+ * Node.js API of web-demuxer, around the same web_demuxer.cpp entry points as the browser build.
+ * Files are read from the host file system by NODEFS, on the calling thread; use one
+ * NodeDemuxer per worker_threads worker to demux on several cores.
+ *
+ * build the module first: make web-demuxer-node (or npm run make:web-demuxer-node)
+ */
+import path from "path";
+import createModule from "./lib/web-demuxer-node.js";
+
+const MEDIA_TYPE_TO_AVMEDIA_TYPE = {
+  video: 0,
+  audio: 1,
+  subtitle: 3,
+};
+const AVSEEK_FLAG_BACKWARD = 1;
+
+export class NodeDemuxer {
+  /**
+   * @param {object} [options]
+   * @param {number} [options.logLevel] FFmpeg log level, default AV_LOG_ERROR (16)
+   * @returns {Promise<NodeDemuxer>}
+   */
+  static async create(options = {}) {
+    const module = await createModule();
+
+    module.setAVLogLevel(options.logLevel ?? 16);
+
+    return new NodeDemuxer(module);
+  }
+
+  constructor(module) {
+    this.module = module;
+  }
+
+  /**
+   * Open a file as a source session, so several calls on it share its I/O stats
+   * @param {string} filePath
+   * @returns {number} source session id
+   */
+  open(filePath) {
+    return this.module.openHostFile(path.resolve(filePath));
+  }
+
+  /**
+   * @param {number} source source session id
+   */
+  close(source) {
+    this.module.closeSource(source);
+  }
+
+  /**
+   * run fn on a source session id, or on a file path opened for this call only,
+   * a session closed during a read is unmounted once the read finishes
+   */
+  withSource(source, fn) {
+    if (typeof source === "number") {
+      return fn(source);
+    }
+
+    const sessionId = this.open(source);
+
+    try {
+      return fn(sessionId);
+    } finally {
+      this.close(sessionId);
+    }
+  }
+
+  /**
+   * @param {string | number} source file path or source session id
+   */
+  getMediaInfo(source) {
+    return this.withSource(source, (sessionId) => this.module.getMediaInfo(sessionId));
+  }
+
+  /**
+   * @param {string | number} source file path or source session id
+   * @param {'video' | 'audio' | 'subtitle'} type
+   * @param {number} [streamIndex]
+   */
+  getMediaStream(source, type, streamIndex = -1) {
+    return this.withSource(source, (sessionId) => this.module.getAVStream(sessionId, MEDIA_TYPE_TO_AVMEDIA_TYPE[type], streamIndex));
+  }
+
+  /**
+   * @param {string | number} source file path or source session id
+   * @param {'video' | 'audio' | 'subtitle'} type
+   * @param {number} time seek time in seconds
+   * @param {number} [seekFlag]
+   */
+  seekMediaPacket(source, type, time, seekFlag = AVSEEK_FLAG_BACKWARD) {
+    return this.withSource(source, (sessionId) => this.module.getAVPacket(sessionId, time, MEDIA_TYPE_TO_AVMEDIA_TYPE[type], -1, seekFlag));
+  }
+
+  /**
+   * One-pass statistics of a stream computed in wasm, see analyzeMediaStream of WebDemuxer
+   * @param {string | number} source file path or source session id
+   * @param {'video' | 'audio' | 'subtitle'} type
+   */
+  analyzeMediaStream(source, type, start = 0, end = 0, bitrateBucket = 1) {
+    return this.withSource(source, (sessionId) => this.module.analyzeStream(sessionId, start, end, MEDIA_TYPE_TO_AVMEDIA_TYPE[type], -1, bitrateBucket));
+  }
+
+  /**
+   * Read packets as a stream
+   * @param {string | number} source file path or source session id
+   * @param {'video' | 'audio' | 'subtitle'} type
+   * @returns {ReadableStream}
+   */
+  readMediaPacket(source, type, start = 0, end = 0, seekFlag = AVSEEK_FLAG_BACKWARD, highWaterMark = 1) {
+    return this.withSource(source, (sessionId) => this.module.readAVPacketStream(
+      sessionId, start, end, MEDIA_TYPE_TO_AVMEDIA_TYPE[type], -1, seekFlag, highWaterMark
+    ));
+  }
+
+  /**
+   * Read keyframe packets only as a stream, see readKeyframeMediaPacket of WebDemuxer
+   * @param {string | number} source file path or source session id
+   * @param {'video' | 'audio' | 'subtitle'} type
+   * @param {{ every?: number, minInterval?: number }} [stride]
+   * @returns {ReadableStream}
+   */
+  readKeyframeMediaPacket(source, type, start = 0, end = 0, stride = {}, highWaterMark = 1) {
+    return this.withSource(source, (sessionId) => this.module.readKeyframePacketStream(
+      sessionId, start, end, MEDIA_TYPE_TO_AVMEDIA_TYPE[type], -1, stride.every, stride.minInterval, highWaterMark
+    ));
+  }
+
+  /**
+   * Timestamps and sizes of the keyframes of a stream, without their data
+   * @param {string | number} source file path or source session id
+   * @param {'video' | 'audio' | 'subtitle'} [type]
+   */
+  async getKeyframeIndex(source, type = "video") {
+    const timestamps = [];
+    const sizes = [];
+
+    for await (const packet of this.readKeyframeMediaPacket(source, type, 0, 0, {}, 16)) {
+      timestamps.push(packet.timestamp);
+      sizes.push(packet.size);
+    }
+
+    return {
+      timestamps: new Float64Array(timestamps),
+      sizes: new Int32Array(sizes),
+    };
+  }
+
+  /**
+   * @param {number} source source session id
+   * @returns {{ bytesRead: number, readCount: number }}
+   */
+  getIOStats(source) {
+    return this.module.getIOStats(source);
+  }
+}
@@ -0,0 +1,24 @@
+import { defineConfig, devices } from '@playwright/test';
+
+// benchmarks run one at a time, so they do not compete for the cpu
+export default defineConfig({
+  testDir: './test/benchmarks',
+  testMatch: '**/*.bench.ts',
+  globalSetup: './test/benchmarks/global-setup.ts',
+  fullyParallel: false,
+  forbidOnly: !!process.env.CI,
+  workers: 1,
+  timeout: 5 * 60 * 1000,
+  reporter: 'list',
+  webServer: {
+    command: 'pnpm run dev',
+    port: 5173,
+    reuseExistingServer: !process.env.CI,
+  },
+  projects: [
+    {
+      name: 'chromium',
+      use: { ...devices['Desktop Chrome'] },
+    },
+  ],
+});
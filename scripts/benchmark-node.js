@@ -0,0 +1,202 @@
+#!/usr/bin/env node
+/**
+ * Probe and scan every media file of a directory with the node build of web-demuxer,
+ * on a pool of worker threads, and report the throughput per core.
+ *
+ * usage: node scripts/benchmark-node.js <dir> [options]
+ *
+ * options:
+ *   --workers <n>      worker threads, one demuxer each (default: number of cores)
+ *   --scan <mode>      after probing: none, keyframes (keyframe index) or packets
+ *                      (one-pass analysis of every video packet) (default: keyframes)
+ *   --ext <list>       file extensions to include (default: mp4,mov,m4v,mkv,webm,avi,flv,ts)
+ *
+ * build the node module first: make web-demuxer-node
+ */
+import fs from "fs";
+import os from "os";
+import path from "path";
+import { Worker, isMainThread, parentPort, workerData } from "worker_threads";
+
+const DEFAULT_EXTENSIONS = "mp4,mov,m4v,mkv,webm,avi,flv,ts";
+
+function parseArgs(argv) {
+  const options = {
+    workers: os.availableParallelism?.() ?? os.cpus().length,
+    scan: "keyframes",
+    extensions: DEFAULT_EXTENSIONS.split(","),
+  };
+  const positional = [];
+
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i];
+
+    switch (arg) {
+      case "--workers":
+        options.workers = Math.max(1, parseInt(argv[++i], 10));
+        break;
+      case "--scan":
+        options.scan = argv[++i];
+        break;
+      case "--ext":
+        options.extensions = argv[++i].split(",").map((ext) => ext.replace(/^\./, "").toLowerCase());
+        break;
+      default:
+        positional.push(arg);
+    }
+  }
+
+  if (positional.length !== 1 || !["none", "keyframes", "packets"].includes(options.scan)) {
+    console.error("usage: node scripts/benchmark-node.js <dir> [--workers 8] [--scan none|keyframes|packets] [--ext mp4,mkv]");
+    process.exit(1);
+  }
+
+  return { dir: positional[0], options };
+}
+
+function listFiles(dir, extensions) {
+  const files = [];
+
+  for (const entry of fs.readdirSync(dir, { withFileTypes: true })) {
+    const filePath = path.join(dir, entry.name);
+
+    if (entry.isDirectory()) {
+      files.push(...listFiles(filePath, extensions));
+    } else if (extensions.includes(path.extname(entry.name).slice(1).toLowerCase())) {
+      files.push(filePath);
+    }
+  }
+
+  return files;
+}
+
+function percentile(values, p) {
+  if (values.length === 0) return 0;
+
+  const sorted = values.slice().sort((a, b) => a - b);
+
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p / 100))];
+}
+
+function formatBytes(bytes) {
+  if (bytes >= 1024 * 1024) return `${(bytes / 1024 / 1024).toFixed(2)} MB`;
+  if (bytes >= 1024) return `${(bytes / 1024).toFixed(1)} KB`;
+  return `${bytes} B`;
+}
+
+// ============ worker ============
+async function runWorker() {
+  const { NodeDemuxer } = await import("../node/index.js");
+  const demuxer = await NodeDemuxer.create();
+  const { scan } = workerData;
+
+  parentPort.on("message", async (filePath) => {
+    const result = { filePath, probeTime: 0, scanTime: 0, bytesRead: 0, keyframes: 0 };
+    let source = -1;
+
+    try {
+      const startTime = performance.now();
+
+      source = demuxer.open(filePath);
+
+      const mediaInfo = demuxer.getMediaInfo(source);
+      const hasVideo = mediaInfo.streams.some((stream) => stream.codec_type_string === "video");
+
+      result.probeTime = performance.now() - startTime;
+
+      if (hasVideo && scan === "keyframes") {
+        result.keyframes = (await demuxer.getKeyframeIndex(source)).timestamps.length;
+      } else if (hasVideo && scan === "packets") {
+        demuxer.analyzeMediaStream(source, "video");
+      }
+
+      result.scanTime = performance.now() - startTime - result.probeTime;
+      result.bytesRead = demuxer.getIOStats(source).bytesRead;
+    } catch (e) {
+      result.error = e.message;
+    } finally {
+      if (source >= 0) {
+        demuxer.close(source);
+      }
+    }
+
+    parentPort.postMessage(result);
+  });
+
+  parentPort.postMessage(null); // ready
+}
+
+// ============ main ============
+async function main() {
+  const { dir, options } = parseArgs(process.argv.slice(2));
+  const files = listFiles(dir, options.extensions);
+
+  if (files.length === 0) {
+    console.error(`no media files in ${dir}`);
+    process.exit(1);
+  }
+
+  const workerCount = Math.min(options.workers, files.length);
+  const results = [];
+  let next = 0;
+
+  const workers = await Promise.all(
+    Array.from({ length: workerCount }, () => new Promise((resolve, reject) => {
+      const worker = new Worker(new URL(import.meta.url), { workerData: { scan: options.scan } });
+
+      worker.once("message", () => resolve(worker));
+      worker.once("error", reject);
+    }))
+  );
+
+  // timed from the moment every demuxer is instantiated
+  const startTime = performance.now();
+
+  await Promise.all(workers.map((worker) => new Promise((resolve, reject) => {
+    const dispatch = () => {
+      if (next < files.length) {
+        worker.postMessage(files[next++]);
+      } else {
+        worker.terminate().then(resolve);
+      }
+    };
+
+    worker.on("message", (result) => {
+      results.push(result);
+      dispatch();
+    });
+    worker.on("error", reject);
+    dispatch();
+  })));
+
+  const wallTime = (performance.now() - startTime) / 1000;
+  const succeeded = results.filter((result) => !result.error);
+  const failed = results.filter((result) => result.error);
+  const bytesRead = succeeded.reduce((sum, result) => sum + result.bytesRead, 0);
+  const filesPerSecond = succeeded.length / wallTime;
+
+  for (const { filePath, error } of failed) {
+    console.warn(`failed: ${filePath}: ${error}`);
+  }
+
+  console.log(`${files.length} files in ${dir}, ${workerCount} workers, scan: ${options.scan}\n`);
+  console.table({
+    files: succeeded.length,
+    failed: failed.length,
+    "wall time (s)": wallTime.toFixed(2),
+    "files/s": filesPerSecond.toFixed(1),
+    "files/s per core": (filesPerSecond / workerCount).toFixed(1),
+    "read/s": formatBytes(bytesRead / wallTime),
+    "read/s per core": formatBytes(bytesRead / wallTime / workerCount),
+    "probe p50 (ms)": percentile(succeeded.map((result) => result.probeTime), 50).toFixed(1),
+    "probe p95 (ms)": percentile(succeeded.map((result) => result.probeTime), 95).toFixed(1),
+    "scan p50 (ms)": percentile(succeeded.map((result) => result.scanTime), 50).toFixed(1),
+    "scan p95 (ms)": percentile(succeeded.map((result) => result.scanTime), 95).toFixed(1),
+  });
+}
+
+if (isMainThread) {
+  main();
+} else {
+  runWorker();
+}
@@ -0,0 +1,242 @@
+#!/usr/bin/env node
+/**
+ * Replay an I/O trace recorded by `WebDemuxer.startIOTrace()` / `stopIOTrace()` against
+ * a local copy of the media file, with different block cache settings.
+ *
+ * usage: node scripts/replay-io-trace.js <trace> <file> [options]
+ *
+ * options:
+ *   --block-size <bytes,...>  block sizes to compare, k / m suffixes allowed (default: 64k,256k,1m)
+ *   --cache-size <bytes>      LRU block cache size (default: 8m)
+ *   --read-ahead <blocks>     extra blocks fetched after each miss (default: 0)
+ *   --rtt <ms>                simulated round trip time per request (default: 50)
+ *   --bandwidth <MB/s>        simulated bandwidth (default: 10)
+ */
+import fs from "fs";
+
+function parseSize(value) {
+  const match = /^(\d+(?:\.\d+)?)([km]?)$/i.exec(value.trim());
+
+  if (!match) {
+    throw new Error(`invalid size: ${value}`);
+  }
+
+  const unit = { "": 1, k: 1024, m: 1024 * 1024 }[match[2].toLowerCase()];
+
+  return Math.round(parseFloat(match[1]) * unit);
+}
+
+function parseArgs(argv) {
+  const options = {
+    blockSizes: [64 * 1024, 256 * 1024, 1024 * 1024],
+    cacheSize: 8 * 1024 * 1024,
+    readAhead: 0,
+    rtt: 50,
+    bandwidth: 10,
+  };
+  const positional = [];
+
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i];
+
+    switch (arg) {
+      case "--block-size":
+        options.blockSizes = argv[++i].split(",").map(parseSize);
+        break;
+      case "--cache-size":
+        options.cacheSize = parseSize(argv[++i]);
+        break;
+      case "--read-ahead":
+        options.readAhead = parseInt(argv[++i], 10);
+        break;
+      case "--rtt":
+        options.rtt = parseFloat(argv[++i]);
+        break;
+      case "--bandwidth":
+        options.bandwidth = parseFloat(argv[++i]);
+        break;
+      default:
+        positional.push(arg);
+    }
+  }
+
+  if (positional.length !== 2) {
+    console.error("usage: node scripts/replay-io-trace.js <trace> <file> [--block-size 64k,256k] [--cache-size 8m] [--read-ahead 0] [--rtt 50] [--bandwidth 10]");
+    process.exit(1);
+  }
+
+  return { tracePath: positional[0], filePath: positional[1], options };
+}
+
+function parseTrace(text) {
+  const lines = text.split("\n");
+  const header = /^# web-demuxer io trace v1 size=(\d+)/.exec(lines[0]);
+
+  if (!header) {
+    throw new Error("not a web-demuxer io trace");
+  }
+
+  const reads = lines
+    .slice(1)
+    .filter((line) => line && !line.startsWith("#"))
+    .map((line) => {
+      const [offset, length, latency] = line.split(",").map(Number);
+      return { offset, length, latency };
+    });
+
+  return { size: parseInt(header[1], 10), reads };
+}
+
+function simulatedTime(bytes, options) {
+  return options.rtt + (bytes / (options.bandwidth * 1024 * 1024)) * 1000;
+}
+
+/**
+ * every read of the trace is one request, as the recorded session did
+ */
+function replayUncached(trace, fd, options) {
+  const result = { requests: 0, bytes: 0, latency: 0 };
+  let buffer = Buffer.alloc(0);
+
+  for (const { offset, length } of trace.reads) {
+    const size = Math.max(0, Math.min(length, trace.size - offset));
+
+    if (size === 0) continue;
+    if (buffer.length < size) buffer = Buffer.alloc(size);
+
+    fs.readSync(fd, buffer, 0, size, offset);
+    result.requests++;
+    result.bytes += size;
+    result.latency += simulatedTime(size, options);
+  }
+
+  return result;
+}
+
+/**
+ * reads go through a LRU cache of fixed size blocks, consecutive missing blocks
+ * of one read are fetched by one request
+ */
+function replayCached(trace, fd, blockSize, options) {
+  const result = { requests: 0, bytes: 0, latency: 0, hits: 0 };
+  const cache = new Map(); // block index -> true, in LRU order
+  const maxBlocks = Math.max(1, Math.floor(options.cacheSize / blockSize));
+  const lastBlock = Math.ceil(trace.size / blockSize) - 1;
+  const buffer = Buffer.alloc(blockSize * (options.readAhead + 1));
+
+  const touch = (block) => {
+    cache.delete(block);
+    cache.set(block, true);
+
+    if (cache.size > maxBlocks) {
+      cache.delete(cache.keys().next().value);
+    }
+  };
+
+  const fetchRun = (first, last) => {
+    const start = first * blockSize;
+    const size = Math.min((last + 1) * blockSize, trace.size) - start;
+    let remaining = size;
+    let position = start;
+
+    // read from the local file in buffer sized chunks, one simulated request
+    while (remaining > 0) {
+      const chunk = Math.min(remaining, buffer.length);
+
+      fs.readSync(fd, buffer, 0, chunk, position);
+      remaining -= chunk;
+      position += chunk;
+    }
+
+    result.requests++;
+    result.bytes += size;
+    result.latency += simulatedTime(size, options);
+
+    for (let block = first; block <= last; block++) {
+      touch(block);
+    }
+  };
+
+  for (const { offset, length } of trace.reads) {
+    if (offset >= trace.size || length <= 0) continue;
+
+    const first = Math.floor(offset / blockSize);
+    const last = Math.min(Math.floor((offset + length - 1) / blockSize), lastBlock);
+    let runStart = -1;
+
+    for (let block = first; block <= last; block++) {
+      if (cache.has(block)) {
+        result.hits++;
+        touch(block);
+
+        if (runStart >= 0) {
+          fetchRun(runStart, block - 1);
+          runStart = -1;
+        }
+      } else if (runStart < 0) {
+        runStart = block;
+      }
+    }
+
+    if (runStart >= 0) {
+      let runEnd = last;
+
+      while (runEnd < lastBlock && runEnd - last < options.readAhead && !cache.has(runEnd + 1)) {
+        runEnd++;
+      }
+      fetchRun(runStart, runEnd);
+    }
+  }
+
+  return result;
+}
+
+function formatBytes(bytes) {
+  if (bytes >= 1024 * 1024) return `${(bytes / 1024 / 1024).toFixed(2)} MB`;
+  if (bytes >= 1024) return `${(bytes / 1024).toFixed(1)} KB`;
+  return `${bytes} B`;
+}
+
+function main() {
+  const { tracePath, filePath, options } = parseArgs(process.argv.slice(2));
+  const trace = parseTrace(fs.readFileSync(tracePath, "utf-8"));
+  const fileSize = fs.statSync(filePath).size;
+
+  if (fileSize !== trace.size) {
+    console.warn(`warning: file size ${fileSize} differs from the traced size ${trace.size}`);
+    trace.size = Math.min(trace.size, fileSize);
+  }
+
+  const recordedLatency = trace.reads.reduce((sum, read) => sum + read.latency, 0);
+  const fd = fs.openSync(filePath, "r");
+  const rows = [];
+
+  try {
+    const startTime = performance.now();
+    const uncached = replayUncached(trace, fd, options);
+
+    rows.push({ mode: "no cache", ...uncached, replayTime: performance.now() - startTime });
+
+    for (const blockSize of options.blockSizes) {
+      const startTime = performance.now();
+      const cached = replayCached(trace, fd, blockSize, options);
+
+      rows.push({ mode: `block ${formatBytes(blockSize)}`, ...cached, replayTime: performance.now() - startTime });
+    }
+  } finally {
+    fs.closeSync(fd);
+  }
+
+  console.log(`trace: ${trace.reads.length} reads of ${formatBytes(trace.size)}, recorded latency ${recordedLatency.toFixed(1)} ms`);
+  console.log(`cache ${formatBytes(options.cacheSize)}, read-ahead ${options.readAhead} blocks, rtt ${options.rtt} ms, bandwidth ${options.bandwidth} MB/s\n`);
+  console.table(rows.map((row) => ({
+    mode: row.mode,
+    requests: row.requests,
+    bytes: formatBytes(row.bytes),
+    "cache hits": row.hits ?? "-",
+    "simulated latency (ms)": Math.round(row.latency),
+    "replay time (ms)": row.replayTime.toFixed(1),
+  })));
+}
+
+main();
@@ -0,0 +1,70 @@
+import { ModuleFormat } from "./types";
+
+/**
+ * Per-format builds link only the demuxer and muxers of one container family, the
+ * worker picks one by the first bytes of a source before loading any wasm.
+ * null stands for the full module, which demuxes every format.
+ */
+
+// bytes read from the start of a source to tell its format
+const FORMAT_HEAD_SIZE = 12;
+
+// top-level atoms a MP4 / MOV file may start with
+const MP4_ATOMS = ["ftyp", "moov", "mdat", "free", "skip", "wide", "pnot"];
+
+const EBML_MAGIC = [0x1a, 0x45, 0xdf, 0xa3];
+
+// demuxer / muxer names of FFmpeg -> module linking them
+const FORMAT_MODULE_BY_NAME: Record<string, ModuleFormat> = {
+  mov: "mp4",
+  mp4: "mp4",
+  matroska: "matroska",
+  webm: "matroska",
+};
+
+export function getModuleFormatByName(name: string): ModuleFormat | null {
+  return FORMAT_MODULE_BY_NAME[name] ?? null;
+}
+
+export function sniffModuleFormat(head: Uint8Array): ModuleFormat | null {
+  if (head.length >= 8 && MP4_ATOMS.includes(String.fromCharCode(...head.subarray(4, 8)))) {
+    return "mp4";
+  }
+
+  if (EBML_MAGIC.every((byte, index) => head[index] === byte)) {
+    return "matroska";
+  }
+
+  return null;
+}
+
+async function readSourceHead(source: File | string) {
+  if (typeof source !== "string") {
+    return new Uint8Array(await source.slice(0, FORMAT_HEAD_SIZE).arrayBuffer());
+  }
+
+  const response = await fetch(source, { headers: { Range: `bytes=0-${FORMAT_HEAD_SIZE - 1}` } });
+
+  if (!response.ok || !response.body) {
+    return new Uint8Array();
+  }
+
+  // a server ignoring the range sends the whole file, only the first chunk is needed
+  const reader = response.body.getReader();
+  const { value } = await reader.read();
+
+  reader.cancel();
+
+  return value ?? new Uint8Array();
+}
+
+/**
+ * format of a source by its first bytes, null when unknown or unreadable
+ */
+export async function getSourceModuleFormat(source: File | string): Promise<ModuleFormat | null> {
+  try {
+    return sniffModuleFormat(await readSourceHead(source));
+  } catch {
+    return null;
+  }
+}
@@ -1,6 +1,6 @@
 import { WebDemuxer } from "./web-demuxer";
 
-export type { WebAVStream, WebAVPacket, WebMediaInfo } from './types';
-export type { WebDemuxerOptions } from './web-demuxer';
+export type { WebAVStream, WebAVPacket, WebMediaInfo, WASMStartupTiming, ReadAheadStrategy, KeyframeStride, PlaybackOptions, WebPlaybackStart, WebAVPlayback, WebCodecsPlayback, WebSampleTable, WebIOStats, WebPacketCacheStats, WebMemoryStats, WebStreamAnalysis, WebProbeResult, URLSourceOptions, FormatModules, ModuleFormat, WebRangeRequestTiming, RequestPriority, WebRequestQueueStats, WebSchedulerStats } from './types';
+export type { WebDemuxerOptions, ProbeManyOptions } from './web-demuxer';
 export { AVMediaType, AVLogLevel, AVSeekFlag } from './types';
 export { WebDemuxer };
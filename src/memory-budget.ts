@@ -0,0 +1,34 @@
+import { URLSourceOptions } from "./types";
+import { DEFAULT_URL_SOURCE_OPTIONS } from "./range-loader";
+
+/**
+ * share of the memory budget one buffer may take: a packet queue, a packet ring,
+ * the block cache or the tail prefetch of a url source, or the packet cache of post.js
+ */
+export const MEMORY_BUDGET_SHARE = 1 / 8;
+
+/**
+ * a buffer size bounded by the memory budget, unchanged without a budget
+ */
+export function budgetSize(size: number, memoryBudget = 0) {
+  if (memoryBudget <= 0) {
+    return size;
+  }
+
+  return Math.min(size, Math.floor(memoryBudget * MEMORY_BUDGET_SHARE));
+}
+
+/**
+ * url source options with the block cache and tail prefetch bounded by the memory budget
+ */
+export function budgetURLSourceOptions(options: URLSourceOptions = {}, memoryBudget = 0): URLSourceOptions {
+  if (memoryBudget <= 0) {
+    return options;
+  }
+
+  return {
+    ...options,
+    cacheSize: budgetSize(options.cacheSize ?? DEFAULT_URL_SOURCE_OPTIONS.cacheSize, memoryBudget),
+    tailPrefetchSize: budgetSize(options.tailPrefetchSize ?? DEFAULT_URL_SOURCE_OPTIONS.tailPrefetchSize, memoryBudget),
+  };
+}
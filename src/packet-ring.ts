@@ -0,0 +1,262 @@
+import { WebAVPacket } from "./types";
+
+/**
+ * Single producer, single consumer packet ring on a SharedArrayBuffer.
+ *
+ * The buffer starts with Int32 control words, followed by a power of two data region.
+ * Indexes are byte counters wrapping at 2^32, positions are index & (capacity - 1).
+ * Each record is a fixed header followed by the packet payload, aligned to 8 bytes,
+ * and may wrap around the end of the data region.
+ */
+const WRITE_INDEX = 0;
+const READ_INDEX = 1;
+const STATE = 2;
+const CONTROL_BYTES = 16;
+
+const STATE_CLOSED = 1; // writer finished
+const STATE_STOPPED = 2; // reader cancelled
+
+// size: int32, stream_index: int32, keyframe: int32, pad, timestamp: float64, duration: float64
+const RECORD_HEADER_BYTES = 32;
+// record size of a packet too large for the ring, the packet itself is posted as a message
+const OUT_OF_BAND_SIZE = -1;
+
+const MIN_CAPACITY = 1 << 12;
+const MAX_CAPACITY = 1 << 30;
+
+export const OUT_OF_BAND_PACKET = Symbol("OUT_OF_BAND_PACKET");
+
+type WaitAsync = (
+  typedArray: Int32Array,
+  index: number,
+  value: number,
+) => { async: boolean; value: Promise<unknown> | string };
+
+// Atomics.waitAsync is not available everywhere, poll as a fallback
+const waitAsync = (Atomics as unknown as { waitAsync?: WaitAsync }).waitAsync;
+const POLL_INTERVAL = 4;
+
+function waitChange(control: Int32Array, index: number, value: number): Promise<unknown> {
+  if (waitAsync) {
+    const result = waitAsync(control, index, value);
+
+    return result.async ? (result.value as Promise<unknown>) : Promise.resolve();
+  }
+
+  return new Promise((resolve) => setTimeout(resolve, POLL_INTERVAL));
+}
+
+function recordBytes(size: number) {
+  return (RECORD_HEADER_BYTES + size + 7) & ~7;
+}
+
+/**
+ * Whether packets can be transferred by a shared ring in this context
+ */
+export function isPacketRingSupported() {
+  return typeof SharedArrayBuffer !== "undefined" && self.crossOriginIsolated;
+}
+
+/**
+ * Create the shared buffer of a ring, the capacity is rounded up to a power of two
+ * @param capacity data capacity in bytes
+ */
+export function createPacketRing(capacity: number) {
+  let size = MIN_CAPACITY;
+
+  while (size < capacity && size < MAX_CAPACITY) {
+    size <<= 1;
+  }
+
+  return new SharedArrayBuffer(CONTROL_BYTES + size);
+}
+
+class PacketRing {
+  protected control: Int32Array;
+  protected data: Uint8Array;
+  protected mask: number;
+  protected header = new Uint8Array(RECORD_HEADER_BYTES);
+  protected headerView = new DataView(this.header.buffer);
+
+  constructor(public readonly buffer: SharedArrayBuffer) {
+    this.control = new Int32Array(buffer, 0, CONTROL_BYTES / Int32Array.BYTES_PER_ELEMENT);
+    this.data = new Uint8Array(buffer, CONTROL_BYTES);
+    this.mask = this.data.byteLength - 1;
+  }
+
+  get capacity() {
+    return this.data.byteLength;
+  }
+
+  get closed() {
+    return (Atomics.load(this.control, STATE) & STATE_CLOSED) !== 0;
+  }
+
+  get stopped() {
+    return (Atomics.load(this.control, STATE) & STATE_STOPPED) !== 0;
+  }
+
+  protected setState(flag: number) {
+    Atomics.or(this.control, STATE, flag);
+    // wake both sides, whoever is waiting
+    Atomics.notify(this.control, WRITE_INDEX);
+    Atomics.notify(this.control, READ_INDEX);
+  }
+
+  protected copyIn(index: number, bytes: Uint8Array) {
+    const position = index & this.mask;
+    const first = Math.min(bytes.byteLength, this.capacity - position);
+
+    this.data.set(bytes.subarray(0, first), position);
+
+    if (first < bytes.byteLength) {
+      this.data.set(bytes.subarray(first), 0);
+    }
+  }
+
+  protected copyOut(index: number, bytes: Uint8Array) {
+    const position = index & this.mask;
+    const first = Math.min(bytes.byteLength, this.capacity - position);
+
+    bytes.set(this.data.subarray(position, position + first));
+
+    if (first < bytes.byteLength) {
+      bytes.set(this.data.subarray(0, bytes.byteLength - first), first);
+    }
+  }
+}
+
+/**
+ * Used in the worker, writes packets without posting a message per packet
+ */
+export class PacketRingWriter extends PacketRing {
+  private free() {
+    const used = (Atomics.load(this.control, WRITE_INDEX) - Atomics.load(this.control, READ_INDEX)) | 0;
+
+    return this.capacity - used;
+  }
+
+  private writeRecord(size: number, packet?: Omit<WebAVPacket, "size">) {
+    const writeIndex = Atomics.load(this.control, WRITE_INDEX);
+    const view = this.headerView;
+
+    view.setInt32(0, size, true);
+    view.setInt32(4, packet?.stream_index ?? 0, true);
+    view.setInt32(8, packet?.keyframe ?? 0, true);
+    view.setFloat64(16, packet?.timestamp ?? 0, true);
+    view.setFloat64(24, packet?.duration ?? 0, true);
+    this.copyIn(writeIndex, this.header);
+
+    if (packet && size > 0) {
+      this.copyIn(writeIndex + RECORD_HEADER_BYTES, packet.data);
+    }
+
+    Atomics.store(this.control, WRITE_INDEX, (writeIndex + recordBytes(Math.max(size, 0))) | 0);
+    Atomics.notify(this.control, WRITE_INDEX);
+  }
+
+  /**
+   * whether the packet payload can ever fit in the ring
+   */
+  fits(size: number) {
+    return recordBytes(size) <= this.capacity;
+  }
+
+  /**
+   * @returns false when the ring is full, wait by waitWritable and retry
+   */
+  write(packet: Omit<WebAVPacket, "size">) {
+    const size = packet.data.byteLength;
+
+    if (recordBytes(size) > this.free()) {
+      return false;
+    }
+
+    this.writeRecord(size, packet);
+
+    return true;
+  }
+
+  /**
+   * keep the order of a packet sent as a message, the reader waits for it at this record
+   * @returns false when the ring is full
+   */
+  writeOutOfBand() {
+    if (RECORD_HEADER_BYTES > this.free()) {
+      return false;
+    }
+
+    this.writeRecord(OUT_OF_BAND_SIZE);
+
+    return true;
+  }
+
+  /**
+   * resolves when the reader consumed something or stopped
+   */
+  waitWritable() {
+    return waitChange(this.control, READ_INDEX, Atomics.load(this.control, READ_INDEX));
+  }
+
+  close() {
+    this.setState(STATE_CLOSED);
+  }
+}
+
+/**
+ * Used on the main thread, reads the packets written by the worker
+ */
+export class PacketRingReader extends PacketRing {
+  /**
+   * @returns a packet, OUT_OF_BAND_PACKET when the next packet comes as a message,
+   * or undefined when the ring is empty
+   */
+  read(): WebAVPacket | typeof OUT_OF_BAND_PACKET | undefined {
+    const readIndex = Atomics.load(this.control, READ_INDEX);
+
+    if (Atomics.load(this.control, WRITE_INDEX) === readIndex) {
+      return;
+    }
+
+    const view = this.headerView;
+
+    this.copyOut(readIndex, this.header);
+
+    const size = view.getInt32(0, true);
+
+    if (size === OUT_OF_BAND_SIZE) {
+      this.advance(readIndex, recordBytes(0));
+      return OUT_OF_BAND_PACKET;
+    }
+
+    const data = new Uint8Array(size);
+
+    this.copyOut(readIndex + RECORD_HEADER_BYTES, data);
+    this.advance(readIndex, recordBytes(size));
+
+    return {
+      stream_index: view.getInt32(4, true),
+      keyframe: view.getInt32(8, true) as 0 | 1,
+      timestamp: view.getFloat64(16, true),
+      duration: view.getFloat64(24, true),
+      size,
+      data,
+    };
+  }
+
+  private advance(readIndex: number, bytes: number) {
+    Atomics.store(this.control, READ_INDEX, (readIndex + bytes) | 0);
+    Atomics.notify(this.control, READ_INDEX);
+  }
+
+  /**
+   * resolves when the writer wrote something, closed, or the reader stopped
+   */
+  waitReadable() {
+    return waitChange(this.control, WRITE_INDEX, Atomics.load(this.control, WRITE_INDEX));
+  }
+
+  stop() {
+    this.setState(STATE_STOPPED);
+  }
+}
@@ -0,0 +1,455 @@
+import {
+  FILE_SIZE_BYTES,
+  SIZE_STATE,
+  UPDATE_SEQUENCE,
+  SLOTS,
+  SLOT_WORDS,
+  SLOT_STATE,
+  SLOT_FILLED,
+  SLOT_STATUS,
+  SIZE_UNKNOWN,
+  SIZE_KNOWN,
+  SIZE_FAILED,
+  SLOT_DONE,
+  SLOT_FAILED,
+  RangeFetchMessage,
+  RangeFetchEvent,
+  RangeRequestOptions,
+  controlBytes,
+} from "./range-loader";
+import { WebRangeRequestTiming } from "./types";
+
+/**
+ * Runs the range requests of every url source of a wasm worker, which blocks while reading.
+ * Response bodies are streamed into the shared slots as they arrive.
+ */
+interface RangeSource {
+  id: number;
+  url: string;
+  fileSize: Float64Array;
+  control: Int32Array;
+  data: Uint8Array;
+  blockSize: number;
+  controllers: Set<AbortController>;
+  closed: boolean;
+  requestOptions: RangeRequestOptions;
+  responseTimes: number[]; // latest response times in ms, for the hedge delay
+}
+
+class RequestError extends Error {
+  constructor(message: string, public status = 0, public retryable = true, public retryAfter = 0) {
+    super(message);
+  }
+}
+
+const MAX_RETRY_DELAY = 8000;
+const RESPONSE_TIME_WINDOW = 64;
+// no hedging until this many response times are known
+const MIN_RESPONSE_TIMES = 8;
+
+const sources = new Map<number, RangeSource>();
+
+self.addEventListener("message", (e: MessageEvent<RangeFetchMessage>) => {
+  const message = e.data;
+
+  switch (message.type) {
+    case "open": {
+      const { id, url, buffer, blockSize, slotCount, requestOptions } = message;
+
+      sources.set(id, {
+        id,
+        url,
+        fileSize: new Float64Array(buffer, 0, 1),
+        control: new Int32Array(buffer, FILE_SIZE_BYTES, controlBytes(slotCount) / Int32Array.BYTES_PER_ELEMENT),
+        data: new Uint8Array(buffer, FILE_SIZE_BYTES + controlBytes(slotCount)),
+        blockSize,
+        controllers: new Set(),
+        closed: false,
+        requestOptions,
+        responseTimes: [],
+      });
+      return;
+    }
+    case "fetch": {
+      const source = sources.get(message.id);
+
+      if (source) {
+        const { slot, start, length } = message;
+
+        fetchRange(source, source.control, SLOTS + slot * SLOT_WORDS, source.data, slot * source.blockSize, start, length);
+      }
+      return;
+    }
+    case "prefetch": {
+      const source = sources.get(message.id);
+
+      if (source) {
+        const { buffer, start, length } = message;
+        const control = new Int32Array(buffer, 0, SLOT_WORDS);
+        const data = new Uint8Array(buffer, SLOT_WORDS * Int32Array.BYTES_PER_ELEMENT);
+
+        fetchRange(source, control, 0, data, 0, start, length);
+      }
+      return;
+    }
+    case "close": {
+      const source = sources.get(message.id);
+
+      if (source) {
+        source.closed = true;
+        source.controllers.forEach((controller) => controller.abort());
+        sources.delete(message.id);
+      }
+      return;
+    }
+  }
+});
+
+function post(event: RangeFetchEvent) {
+  self.postMessage(event);
+}
+
+function notifyUpdate(source: RangeSource) {
+  Atomics.add(source.control, UPDATE_SEQUENCE, 1);
+  Atomics.notify(source.control, UPDATE_SEQUENCE);
+}
+
+function publishSize(source: RangeSource, size: number) {
+  source.fileSize[0] = size;
+  Atomics.store(source.control, SIZE_STATE, SIZE_KNOWN);
+  notifyUpdate(source);
+}
+
+/**
+ * the total size from Content-Range, or Content-Length when the range was ignored
+ */
+function getResponseSize(response: Response) {
+  const contentRange = /\/(\d+)$/.exec(response.headers.get("Content-Range") ?? "");
+
+  if (contentRange) {
+    return parseInt(contentRange[1], 10);
+  }
+
+  if (response.status === 200 && response.headers.has("Content-Length")) {
+    return parseInt(response.headers.get("Content-Length")!, 10);
+  }
+
+  return -1;
+}
+
+async function fetchSize(source: RangeSource) {
+  try {
+    const response = await fetch(source.url, { method: "HEAD" });
+    const size = parseInt(response.headers.get("Content-Length") ?? "", 10);
+
+    if (response.ok && size >= 0) {
+      publishSize(source, size);
+      return;
+    }
+  } catch (e) {
+    // reported below
+  }
+
+  Atomics.store(source.control, SIZE_STATE, SIZE_FAILED);
+  notifyUpdate(source);
+}
+
+/**
+ * yields the body chunks, fails when no chunk arrives within the request timeout
+ */
+async function* readChunks(response: Response, timeout: number, controller: AbortController) {
+  if (!response.body) {
+    yield new Uint8Array(await response.arrayBuffer());
+    return;
+  }
+
+  const reader = response.body.getReader();
+  let timer = 0;
+
+  try {
+    while (true) {
+      const { done, value } = await Promise.race([
+        reader.read(),
+        new Promise<never>((_, reject) => {
+          timer = self.setTimeout(() => {
+            controller.abort();
+            reject(new RequestError("response body stalled"));
+          }, timeout);
+        }),
+      ]);
+
+      clearTimeout(timer);
+
+      if (done) return;
+      yield value;
+    }
+  } finally {
+    clearTimeout(timer);
+    reader.cancel().catch(() => {});
+  }
+}
+
+function wait(duration: number) {
+  return new Promise((resolve) => setTimeout(resolve, duration));
+}
+
+/**
+ * exponential backoff with full jitter, or the Retry-After of the server
+ */
+function getRetryDelay(source: RangeSource, retry: number, retryAfter: number) {
+  if (retryAfter > 0) {
+    return Math.min(retryAfter, MAX_RETRY_DELAY);
+  }
+
+  const maxDelay = Math.min(source.requestOptions.retryDelay * 2 ** (retry - 1), MAX_RETRY_DELAY);
+
+  return maxDelay / 2 + Math.random() * maxDelay / 2;
+}
+
+/**
+ * the configured percentile of recent response times, or 0 to not hedge
+ */
+function getHedgeDelay(source: RangeSource) {
+  const { hedgePercentile, minHedgeDelay } = source.requestOptions;
+  const { responseTimes } = source;
+
+  if (hedgePercentile <= 0 || responseTimes.length < MIN_RESPONSE_TIMES) {
+    return 0;
+  }
+
+  const sorted = responseTimes.slice().sort((a, b) => a - b);
+  const index = Math.min(sorted.length - 1, Math.floor(sorted.length * hedgePercentile / 100));
+
+  return Math.max(sorted[index], minHedgeDelay);
+}
+
+function addResponseTime(source: RangeSource, responseTime: number) {
+  source.responseTimes.push(responseTime);
+
+  if (source.responseTimes.length > RESPONSE_TIME_WINDOW) {
+    source.responseTimes.shift();
+  }
+}
+
+/**
+ * fetch a range, and fetch it again when no response arrived within the hedge delay,
+ * the first response wins and the other request is aborted
+ */
+function fetchHedged(source: RangeSource, range: string, timing: WebRangeRequestTiming) {
+  const hedgeDelay = getHedgeDelay(source);
+  const { requestTimeout } = source.requestOptions;
+  const controllers: AbortController[] = [];
+
+  return new Promise<{ response: Response; controller: AbortController }>((resolve, reject) => {
+    let settled = false;
+    let pending = 0;
+    let hedgeTimer = 0;
+
+    const settle = () => {
+      settled = true;
+      clearTimeout(hedgeTimer);
+      clearTimeout(timeoutTimer);
+    };
+    const start = () => {
+      const controller = new AbortController();
+      const requestStart = performance.now();
+
+      controllers.push(controller);
+      source.controllers.add(controller);
+      pending++;
+
+      fetch(source.url, { headers: { Range: range }, signal: controller.signal }).then((response) => {
+        pending--;
+
+        if (settled) {
+          controller.abort();
+          source.controllers.delete(controller);
+          return;
+        }
+
+        settle();
+        addResponseTime(source, performance.now() - requestStart);
+        timing.ttfb = performance.now() - requestStart;
+
+        for (const other of controllers) {
+          if (other !== controller) {
+            other.abort();
+            source.controllers.delete(other);
+          }
+        }
+
+        resolve({ response, controller });
+      }, (e) => {
+        pending--;
+        source.controllers.delete(controller);
+
+        // fail fast instead of waiting for the hedge timer
+        if (!settled && pending === 0) {
+          settle();
+          reject(e);
+        }
+      });
+    };
+    const timeoutTimer = self.setTimeout(() => {
+      if (settled) return;
+
+      settle();
+      controllers.forEach((controller) => {
+        controller.abort();
+        source.controllers.delete(controller);
+      });
+      reject(new RequestError("request timed out"));
+    }, requestTimeout);
+
+    start();
+
+    if (hedgeDelay > 0) {
+      hedgeTimer = self.setTimeout(() => {
+        if (settled) return;
+
+        timing.hedged = true;
+        start();
+      }, hedgeDelay);
+    }
+  });
+}
+
+function isRetryableStatus(status: number) {
+  return status === 408 || status === 429 || status >= 500;
+}
+
+/**
+ * fetch a range into data at offset, its state words start at control[base]:
+ * a block slot of the source, or the buffer of a prefetch
+ */
+async function fetchRange(
+  source: RangeSource,
+  control: Int32Array,
+  base: number,
+  data: Uint8Array,
+  offset: number,
+  start: number,
+  length: number,
+) {
+  const { requestOptions } = source;
+  const word = (index: number) => base + index;
+  const requestStart = performance.now();
+  const timing: WebRangeRequestTiming = {
+    start,
+    length,
+    startTime: performance.timeOrigin + requestStart,
+    ttfb: 0,
+    duration: 0,
+    attempts: 0,
+    hedged: false,
+    status: 0,
+  };
+  let filled = 0;
+  let failed = true;
+  let retryAfter = 0;
+
+  // a failed request resumes from the bytes already received
+  for (let attempt = 0; attempt <= requestOptions.retries && !source.closed; attempt++) {
+    if (attempt > 0) {
+      await wait(getRetryDelay(source, attempt, retryAfter));
+
+      if (source.closed) return;
+    }
+
+    timing.attempts++;
+
+    let controller: AbortController | undefined;
+
+    try {
+      const range = `bytes=${start + filled}-${start + length - 1}`;
+      const result = await fetchHedged(source, range, timing);
+      const { response } = result;
+
+      controller = result.controller;
+      timing.status = response.status;
+
+      if (response.status !== 206 && response.status !== 200) {
+        throw new RequestError(
+          `range request failed: ${response.status}`,
+          response.status,
+          isRetryableStatus(response.status),
+          parseFloat(response.headers.get("Retry-After") ?? "") * 1000 || 0,
+        );
+      }
+
+      if (Atomics.load(source.control, SIZE_STATE) === SIZE_UNKNOWN) {
+        const size = getResponseSize(response);
+
+        if (size >= 0) {
+          publishSize(source, size);
+        }
+      }
+
+      // the whole file is returned when the server ignores the range
+      let skip = response.status === 200 ? start + filled : 0;
+
+      for await (let chunk of readChunks(response, requestOptions.requestTimeout, controller)) {
+        if (skip > 0) {
+          if (chunk.byteLength <= skip) {
+            skip -= chunk.byteLength;
+            continue;
+          }
+          chunk = chunk.subarray(skip);
+          skip = 0;
+        }
+
+        chunk = chunk.subarray(0, length - filled);
+        data.set(chunk, offset + filled);
+        filled += chunk.byteLength;
+        Atomics.store(control, word(SLOT_FILLED), filled);
+        notifyUpdate(source);
+
+        if (filled >= length) break;
+      }
+
+      // a body shorter than the range, before the end of the file
+      if (Atomics.load(source.control, SIZE_STATE) === SIZE_KNOWN &&
+        filled < Math.min(length, source.fileSize[0] - start)) {
+        throw new RequestError("range response ended early", response.status);
+      }
+
+      failed = false;
+      break;
+    } catch (e) {
+      if (source.closed) return;
+
+      if (e instanceof RequestError) {
+        retryAfter = e.retryAfter;
+
+        if (!e.retryable) break;
+      } else {
+        retryAfter = 0;
+      }
+    } finally {
+      if (controller) {
+        source.controllers.delete(controller);
+      }
+    }
+  }
+
+  timing.duration = performance.now() - requestStart;
+  post({ type: "timing", id: source.id, timing });
+
+  if (failed) {
+    Atomics.store(control, word(SLOT_STATUS), timing.status);
+  }
+
+  Atomics.store(control, word(SLOT_STATE), failed ? SLOT_FAILED : SLOT_DONE);
+  notifyUpdate(source);
+
+  if (Atomics.load(source.control, SIZE_STATE) === SIZE_UNKNOWN) {
+    if (failed) {
+      Atomics.store(source.control, SIZE_STATE, SIZE_FAILED);
+      notifyUpdate(source);
+    } else {
+      await fetchSize(source);
+    }
+  }
+}
+
+post({ type: "ready" });
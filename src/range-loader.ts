@@ -0,0 +1,408 @@
+import { URLSourceOptions, WebRangeRequestTiming } from "./types";
+
+/**
+ * Parallel range requests for url sources, bridged to the synchronous reads of FFmpeg.
+ *
+ * The demuxer reads a url in fixed size blocks. Missing blocks and the blocks after a
+ * sequential read are fetched by a range fetch worker, several at once, into the slots
+ * of a SharedArrayBuffer. The wasm worker blocks by Atomics.wait until the bytes of the
+ * current read arrive, while the following blocks keep downloading.
+ *
+ * Buffer layout: Float64 file size, then Int32 control words (size state, update sequence,
+ * then SLOT_WORDS per slot), then one block of data per slot.
+ */
+export const FILE_SIZE_BYTES = 8;
+export const SIZE_STATE = 0;
+export const UPDATE_SEQUENCE = 1; // bumped on every update, the only word the reader waits on
+export const SLOTS = 2;
+export const SLOT_WORDS = 4;
+export const SLOT_STATE = 0;
+export const SLOT_FILLED = 1;
+export const SLOT_STATUS = 2; // http status of a failed request, 0 for network errors
+
+export const SIZE_UNKNOWN = 0;
+export const SIZE_KNOWN = 1;
+export const SIZE_FAILED = 2;
+
+export const SLOT_IDLE = 0;
+export const SLOT_PENDING = 1;
+export const SLOT_DONE = 2;
+export const SLOT_FAILED = 3;
+
+export type RangeRequestOptions = Required<
+  Pick<URLSourceOptions, "retries" | "retryDelay" | "hedgePercentile" | "minHedgeDelay" | "requestTimeout">
+>;
+
+export type RangeFetchMessage =
+  | {
+    type: "open";
+    id: number;
+    url: string;
+    buffer: SharedArrayBuffer;
+    blockSize: number;
+    slotCount: number;
+    requestOptions: RangeRequestOptions;
+  }
+  | { type: "fetch"; id: number; slot: number; start: number; length: number }
+  // one range fetched into its own buffer, SLOT_WORDS of state then the data
+  | { type: "prefetch"; id: number; buffer: SharedArrayBuffer; start: number; length: number }
+  | { type: "close"; id: number };
+
+export type RangeFetchEvent =
+  | { type: "ready" }
+  | { type: "timing"; id: number; timing: WebRangeRequestTiming };
+
+export const DEFAULT_URL_SOURCE_OPTIONS: Required<URLSourceOptions> = {
+  blockSize: 256 * 1024,
+  readAhead: 4,
+  maxConcurrentRequests: 4,
+  cacheSize: 8 * 1024 * 1024,
+  retries: 3,
+  retryDelay: 200,
+  hedgePercentile: 95,
+  minHedgeDelay: 50,
+  requestTimeout: 10000,
+  tailPrefetchSize: 16 * 1024 * 1024,
+};
+
+// request timings kept per source
+const MAX_REQUEST_TIMINGS = 1024;
+
+/**
+ * Whether url sources can be read by parallel range requests in this context
+ */
+export function isRangeLoaderSupported() {
+  return typeof SharedArrayBuffer !== "undefined" && self.crossOriginIsolated;
+}
+
+export function controlBytes(slotCount: number) {
+  return (SLOTS + slotCount * SLOT_WORDS) * Int32Array.BYTES_PER_ELEMENT;
+}
+
+let loaderIdCounter = 0;
+const loaders = new Map<number, RangeLoader>();
+
+/**
+ * Used in the wasm worker, one per mounted url
+ */
+export class RangeLoader {
+  private id = ++loaderIdCounter;
+  private fileSize: Float64Array;
+  private control: Int32Array;
+  private data: Uint8Array;
+  private blockSize: number;
+  private readAhead: number;
+  private maxCacheBlocks: number;
+  private slotBlocks: number[]; // block index per slot, -1 when free
+  private inFlight = new Map<number, number>(); // block index -> slot
+  private cache = new Map<number, Uint8Array>(); // block index -> bytes, in LRU order
+  private lastBlock = -1;
+  private size = -1;
+  private requestTimings: WebRangeRequestTiming[] = [];
+  private maxPrefetchSize: number;
+  private prefetched?: { start: number; length: number; control: Int32Array; data: Uint8Array };
+
+  /**
+   * timings are posted by the fetch worker and arrive whenever the wasm worker is idle
+   */
+  static addRequestTiming(id: number, timing: WebRangeRequestTiming) {
+    const loader = loaders.get(id);
+
+    if (!loader) return;
+
+    loader.requestTimings.push(timing);
+
+    if (loader.requestTimings.length > MAX_REQUEST_TIMINGS) {
+      loader.requestTimings.shift();
+    }
+  }
+
+  constructor(private fetchWorker: Worker, private url: string, options?: URLSourceOptions) {
+    const {
+      blockSize,
+      readAhead,
+      maxConcurrentRequests,
+      cacheSize,
+      tailPrefetchSize,
+      ...requestOptions
+    } = { ...DEFAULT_URL_SOURCE_OPTIONS, ...options };
+    const slotCount = Math.max(1, maxConcurrentRequests);
+    const buffer = new SharedArrayBuffer(FILE_SIZE_BYTES + controlBytes(slotCount) + slotCount * blockSize);
+
+    this.fileSize = new Float64Array(buffer, 0, 1);
+    this.control = new Int32Array(buffer, FILE_SIZE_BYTES, controlBytes(slotCount) / Int32Array.BYTES_PER_ELEMENT);
+    this.data = new Uint8Array(buffer, FILE_SIZE_BYTES + controlBytes(slotCount));
+    this.blockSize = blockSize;
+    this.readAhead = readAhead;
+    this.maxPrefetchSize = tailPrefetchSize;
+    // every slot must fit in the cache, blocks are harvested while a read is in progress
+    this.maxCacheBlocks = Math.max(Math.floor(cacheSize / blockSize), slotCount * 2);
+    this.slotBlocks = new Array(slotCount).fill(-1);
+
+    loaders.set(this.id, this);
+    this.post({ type: "open", id: this.id, url, buffer, blockSize, slotCount, requestOptions });
+  }
+
+  private post(message: RangeFetchMessage) {
+    this.fetchWorker.postMessage(message);
+  }
+
+  private slotWord(slot: number, word: number) {
+    return SLOTS + slot * SLOT_WORDS + word;
+  }
+
+  /**
+   * block until the fetch worker updates anything
+   */
+  private waitUpdate(sequence: number) {
+    Atomics.wait(this.control, UPDATE_SEQUENCE, sequence);
+  }
+
+  getSize() {
+    if (this.size >= 0) return this.size;
+
+    // the size comes with the response headers of the first block
+    if (this.inFlight.size === 0 && !this.cache.has(0)) {
+      this.request(0, true);
+    }
+
+    while (true) {
+      const sequence = Atomics.load(this.control, UPDATE_SEQUENCE);
+      const state = Atomics.load(this.control, SIZE_STATE);
+
+      if (state === SIZE_KNOWN) break;
+      if (state === SIZE_FAILED) {
+        throw new Error(`get size failed: ${this.url}`);
+      }
+
+      this.waitUpdate(sequence);
+    }
+
+    this.size = this.fileSize[0];
+
+    return this.size;
+  }
+
+  read(buffer: Int8Array, offset: number, length: number, position: number) {
+    const size = this.getSize();
+    const end = Math.min(position + length, size);
+
+    if (position >= end) return 0;
+
+    const prefetched = this.readPrefetched(buffer, offset, position, end);
+
+    if (prefetched >= 0) return prefetched;
+
+    const blockSize = this.blockSize;
+    const first = Math.floor(position / blockSize);
+    const last = Math.floor((end - 1) / blockSize);
+    const lastFileBlock = Math.floor((size - 1) / blockSize);
+
+    // start every missing block of this read at once, then read ahead on sequential reads
+    for (let block = first; block <= last; block++) {
+      this.request(block, false);
+    }
+
+    if (first === this.lastBlock || first === this.lastBlock + 1) {
+      for (let block = last + 1; block <= Math.min(last + this.readAhead, lastFileBlock); block++) {
+        this.request(block, false);
+      }
+    }
+
+    let copied = 0;
+
+    for (let block = first; block <= last; block++) {
+      const blockStart = block * blockSize;
+      const from = Math.max(position, blockStart) - blockStart;
+      const to = Math.min(end, blockStart + blockSize) - blockStart;
+      const bytes = this.waitBlock(block, to);
+
+      buffer.set(bytes.subarray(from, to), offset + copied);
+      copied += to - from;
+    }
+
+    this.lastBlock = last;
+
+    return copied;
+  }
+
+  /**
+   * @param demanded wait for a free slot, otherwise skip when all slots are busy
+   */
+  private request(block: number, demanded: boolean) {
+    if (this.cache.has(block) || this.inFlight.has(block)) return;
+
+    let sequence = Atomics.load(this.control, UPDATE_SEQUENCE);
+    let slot = this.freeSlot();
+
+    while (slot < 0) {
+      if (!demanded) return;
+
+      this.waitUpdate(sequence);
+      sequence = Atomics.load(this.control, UPDATE_SEQUENCE);
+      slot = this.freeSlot();
+    }
+
+    Atomics.store(this.control, this.slotWord(slot, SLOT_FILLED), 0);
+    Atomics.store(this.control, this.slotWord(slot, SLOT_STATE), SLOT_PENDING);
+    this.slotBlocks[slot] = block;
+    this.inFlight.set(block, slot);
+    this.post({ type: "fetch", id: this.id, slot, start: block * this.blockSize, length: this.blockSize });
+  }
+
+  private freeSlot() {
+    for (let slot = 0; slot < this.slotBlocks.length; slot++) {
+      const state = Atomics.load(this.control, this.slotWord(slot, SLOT_STATE));
+
+      if (state === SLOT_DONE) {
+        this.harvest(slot);
+      } else if (state === SLOT_FAILED) {
+        // a failed read ahead, requested again when it is read
+        this.release(slot);
+      }
+    }
+
+    return this.slotBlocks.indexOf(-1);
+  }
+
+  /**
+   * move the bytes of a finished slot into the cache
+   */
+  private harvest(slot: number) {
+    const block = this.slotBlocks[slot];
+    const filled = Atomics.load(this.control, this.slotWord(slot, SLOT_FILLED));
+    const start = slot * this.blockSize;
+    const bytes = this.data.slice(start, start + filled);
+
+    this.release(slot);
+    this.cache.set(block, bytes);
+
+    if (this.cache.size > this.maxCacheBlocks) {
+      this.cache.delete(this.cache.keys().next().value!);
+    }
+
+    return bytes;
+  }
+
+  private release(slot: number) {
+    this.inFlight.delete(this.slotBlocks[slot]);
+    this.slotBlocks[slot] = -1;
+    Atomics.store(this.control, this.slotWord(slot, SLOT_STATE), SLOT_IDLE);
+  }
+
+  /**
+   * @returns the bytes of a block, at least `to` bytes of it
+   */
+  private waitBlock(block: number, to: number) {
+    const cached = this.cache.get(block);
+
+    if (cached) {
+      this.cache.delete(block);
+      this.cache.set(block, cached);
+
+      return cached;
+    }
+
+    this.request(block, true);
+
+    const slot = this.inFlight.get(block)!;
+    const start = slot * this.blockSize;
+
+    while (true) {
+      const sequence = Atomics.load(this.control, UPDATE_SEQUENCE);
+      const state = Atomics.load(this.control, this.slotWord(slot, SLOT_STATE));
+      const filled = Atomics.load(this.control, this.slotWord(slot, SLOT_FILLED));
+
+      if (state === SLOT_DONE) {
+        const bytes = this.harvest(slot);
+
+        if (bytes.byteLength < to) {
+          throw new Error(`range response ended early: ${this.url}`);
+        }
+
+        return bytes;
+      }
+
+      if (state === SLOT_FAILED) {
+        const status = Atomics.load(this.control, this.slotWord(slot, SLOT_STATUS));
+
+        this.release(slot);
+        throw new Error(`range request failed: ${this.url}, status ${status}`);
+      }
+
+      // serve the read as soon as its bytes arrive, the rest of the block keeps streaming
+      if (filled >= to) {
+        return this.data.subarray(start, start + filled);
+      }
+
+      this.waitUpdate(sequence);
+    }
+  }
+
+  /**
+   * fetch a range in one request, up to tailPrefetchSize bytes,
+   * reads inside it are served from it once its bytes arrive
+   */
+  prefetch(start: number, length: number) {
+    length = Math.min(length, this.maxPrefetchSize);
+
+    if (this.prefetched || length <= 0) return;
+
+    const buffer = new SharedArrayBuffer(SLOT_WORDS * Int32Array.BYTES_PER_ELEMENT + length);
+
+    this.prefetched = {
+      start,
+      length,
+      control: new Int32Array(buffer, 0, SLOT_WORDS),
+      data: new Uint8Array(buffer, SLOT_WORDS * Int32Array.BYTES_PER_ELEMENT),
+    };
+    Atomics.store(this.prefetched.control, SLOT_STATE, SLOT_PENDING);
+    this.post({ type: "prefetch", id: this.id, buffer, start, length });
+  }
+
+  /**
+   * @returns bytes copied from the prefetched range, -1 when the read is not inside it
+   */
+  private readPrefetched(buffer: Int8Array, offset: number, position: number, end: number) {
+    const prefetched = this.prefetched;
+
+    if (!prefetched || position < prefetched.start || end > prefetched.start + prefetched.length) {
+      return -1;
+    }
+
+    const { control, data } = prefetched;
+    const from = position - prefetched.start;
+    const to = end - prefetched.start;
+
+    while (true) {
+      const sequence = Atomics.load(this.control, UPDATE_SEQUENCE);
+      const state = Atomics.load(control, SLOT_STATE);
+      const filled = Atomics.load(control, SLOT_FILLED);
+
+      if (filled >= to) {
+        buffer.set(data.subarray(from, to), offset);
+        return to - from;
+      }
+
+      // a failed or short prefetch falls back to block requests
+      if (state === SLOT_DONE || state === SLOT_FAILED) {
+        this.prefetched = undefined;
+        return -1;
+      }
+
+      this.waitUpdate(sequence);
+    }
+  }
+
+  getRequestTimings() {
+    return this.requestTimings.slice();
+  }
+
+  close() {
+    loaders.delete(this.id);
+    this.post({ type: "close", id: this.id });
+    this.cache.clear();
+    this.inFlight.clear();
+    this.prefetched = undefined;
+  }
+}
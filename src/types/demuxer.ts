@@ -37,6 +37,7 @@ export interface WebAVStream {
 }
 
 export interface WebAVPacket {
+  stream_index: number;
   keyframe: 0 | 1;
   timestamp: number;
   duration: number;
@@ -44,6 +45,313 @@ export interface WebAVPacket {
   data: Uint8Array;
 }
 
+/**
+ * per-sample table of a MP4/MOV stream in decode order, one array element per sample
+ */
+export interface WebSampleTable {
+  stream_index: number;
+  /**
+   * decode timestamps in seconds
+   */
+  timestamps: Float64Array;
+  /**
+   * byte offsets in the file
+   */
+  offsets: Float64Array;
+  sizes: Int32Array;
+  /**
+   * 1 for sync samples
+   */
+  keyframes: Uint8Array;
+}
+
+export interface WebStreamAnalysis {
+  stream_index: number;
+  packet_count: number;
+  keyframe_count: number;
+  total_size: number;
+  max_packet_size: number;
+  start_time: number;
+  end_time: number;
+  /**
+   * GOP length in packets and the number of GOPs with this length, sorted by length
+   */
+  gop_histogram: { length: number; count: number }[];
+  min_keyframe_interval: number;
+  max_keyframe_interval: number;
+  avg_keyframe_interval: number;
+  /**
+   * bucket duration in seconds of bitrate_series
+   */
+  bitrate_bucket: number;
+  /**
+   * bits per second of each bucket from start_time
+   */
+  bitrate_series: number[];
+  has_b_frames: 0 | 1;
+  missing_pts_count: number;
+  non_monotonic_dts_count: number;
+  pts_before_dts_count: number;
+  /**
+   * dts in seconds where timestamps jump, at most 100
+   */
+  discontinuities: number[];
+}
+
+export interface WebProbeResult {
+  /**
+   * index in the probed sources
+   */
+  index: number;
+  source: File | string;
+  mediaInfo?: WebMediaInfo;
+  error?: string;
+  /**
+   * time spent probing in the worker in ms
+   */
+  probeTime: number;
+}
+
+/**
+ * reads from the loaded source since it was opened
+ */
+export interface WebIOStats {
+  bytesRead: number;
+  readCount: number;
+  /**
+   * wasm heap size of the worker in bytes, the heap only shrinks when the module instance is recycled
+   */
+  heapSize: number;
+  /**
+   * keyframes of seekMediaPacket / seek answered from the worker packet cache
+   */
+  packetCache: WebPacketCacheStats;
+  /**
+   * timing of the latest network requests of a url source, oldest first
+   */
+  requests?: WebRangeRequestTiming[];
+}
+
+export interface WebPacketCacheStats {
+  hits: number;
+  misses: number;
+  /**
+   * hits / (hits + misses), 0 before the first lookup
+   */
+  hitRate: number;
+  /**
+   * bytes of packets of the source in the cache
+   */
+  size: number;
+}
+
+/**
+ * wasm heap of a worker, shared by every instance on the worker
+ */
+export interface WebMemoryStats {
+  /**
+   * wasm memory size in bytes, it never shrinks until the module instance is recycled
+   */
+  heapSize: number;
+  /**
+   * bytes allocated by malloc
+   */
+  heapUsed: number;
+  /**
+   * free share of the malloc arena, held by the module instance until it is recycled,
+   * memory malloc has never used does not count
+   */
+  fragmentation: number;
+  /**
+   * memoryBudget option of the worker, 0 for none
+   */
+  memoryBudget: number;
+}
+
+export interface WebRangeRequestTiming {
+  /**
+   * requested byte range
+   */
+  start: number;
+  length: number;
+  /**
+   * epoch time in ms when the request was issued
+   */
+  startTime: number;
+  /**
+   * ms until the response headers of the successful attempt
+   */
+  ttfb: number;
+  /**
+   * ms until the range was complete or failed, including retries
+   */
+  duration: number;
+  attempts: number;
+  /**
+   * whether a duplicate request was issued after the hedge delay
+   */
+  hedged: boolean;
+  /**
+   * http status of the last response, 0 for network errors
+   */
+  status: number;
+}
+
+/**
+ * bounded queue of packets demuxed ahead of the consumer
+ */
+export interface ReadAheadStrategy {
+  /**
+   * max queued size in unit, default 1
+   */
+  highWaterMark?: number;
+  /**
+   * unit of highWaterMark, default 'packets'.
+   * in 'seconds', packets are measured by their duration
+   */
+  unit?: "packets" | "bytes" | "seconds";
+}
+
+/**
+ * which keyframes a keyframe-only read keeps, for trick play
+ */
+export interface KeyframeStride {
+  /**
+   * keep every Nth keyframe, default 1
+   */
+  every?: number;
+  /**
+   * minimum spacing of kept keyframes in seconds, default 0
+   */
+  minInterval?: number;
+}
+
+/**
+ * scheduling class of the requests of an instance in its worker: interactive requests
+ * (media info, seek) run first, then playback reads, then background work (export, analysis)
+ */
+export type RequestPriority = "interactive" | "playback" | "background";
+
+export interface WebRequestQueueStats {
+  /**
+   * requests run at this priority
+   */
+  requests: number;
+  /**
+   * time requests waited in the queue before they started, in ms
+   */
+  avgWaitTime: number;
+  maxWaitTime: number;
+  /**
+   * times a long read gave way to other requests and resumed
+   */
+  slices: number;
+  /**
+   * requests and slices waiting now
+   */
+  queued: number;
+}
+
+export type WebSchedulerStats = Record<RequestPriority, WebRequestQueueStats>;
+
+/**
+ * which streams startPlayback reads: true for the best stream of the type (default),
+ * false to leave it out, or a stream index
+ */
+export interface PlaybackOptions {
+  video?: boolean | number;
+  audio?: boolean | number;
+  /**
+   * end time in seconds, 0 means till end
+   */
+  end?: number;
+  readAhead?: ReadAheadStrategy;
+}
+
+export interface WebPlaybackStart {
+  /**
+   * the selected streams, video first
+   */
+  streams: WebAVStream[];
+  /**
+   * first keyframe at the start time, of the video stream if selected
+   */
+  packet: WebAVPacket;
+}
+
+export interface WebAVPlayback extends WebPlaybackStart {
+  /**
+   * packets of the selected streams following `packet`, in file order
+   */
+  packets: ReadableStream<WebAVPacket>;
+}
+
+/**
+ * wasm file paths of per-format builds, by the container format they demux
+ */
+export interface FormatModules {
+  /**
+   * mov, mp4, m4a, 3gp, 3g2, mj2, built by `make web-demuxer-mp4`
+   */
+  mp4?: string;
+  /**
+   * matroska, webm, built by `make web-demuxer-matroska`
+   */
+  matroska?: string;
+}
+
+export type ModuleFormat = keyof FormatModules;
+
+/**
+ * how url sources are read, by parallel range requests when cross-origin isolated
+ */
+export interface URLSourceOptions {
+  /**
+   * bytes per range request, default 256KB
+   */
+  blockSize?: number;
+  /**
+   * blocks requested ahead of sequential reads, default 4
+   */
+  readAhead?: number;
+  /**
+   * range requests in flight per source, default 4
+   */
+  maxConcurrentRequests?: number;
+  /**
+   * bytes of fetched blocks kept per source, default 8MB
+   */
+  cacheSize?: number;
+  /**
+   * retries of a failed request, with exponential backoff from retryDelay, default 3
+   */
+  retries?: number;
+  /**
+   * ms before the first retry, doubled per retry up to 8s, default 200.
+   * Without cross-origin isolation the worker can only wait by spinning a core,
+   * so each wait is capped at 100ms there
+   */
+  retryDelay?: number;
+  /**
+   * issue a duplicate request when no response arrived within this percentile of the recent
+   * response times, 0 to disable, default 95
+   */
+  hedgePercentile?: number;
+  /**
+   * lower bound of the hedge delay in ms, default 50
+   */
+  minHedgeDelay?: number;
+  /**
+   * ms without any received byte before a request is retried, default 10000
+   */
+  requestTimeout?: number;
+  /**
+   * max bytes fetched in one request from the end of a MP4 whose moov is stored after mdat,
+   * 0 to disable, default 16MB
+   */
+  tailPrefetchSize?: number;
+}
+
 export interface WebMediaInfo {
   format_name: string;
   start_time: number;
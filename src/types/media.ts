@@ -36,3 +36,16 @@ export type MediaTypeToChunk = {
   [VIDEO]: EncodedVideoChunk;
   [AUDIO]: EncodedAudioChunk;
 }
+
+export interface WebCodecsPlayback {
+  videoDecoderConfig?: ExtendedVideoDecoderConfig;
+  audioDecoderConfig?: AudioDecoderConfig;
+  /**
+   * first keyframe at the start time, of the video stream if selected
+   */
+  chunk: EncodedVideoChunk | EncodedAudioChunk;
+  /**
+   * chunks of the selected streams following `chunk`, in file order
+   */
+  chunks: ReadableStream<EncodedVideoChunk | EncodedAudioChunk>;
+}
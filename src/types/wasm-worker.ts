@@ -1,19 +1,46 @@
 import { AVLogLevel, AVMediaType, AVSeekFlag } from "./avutil";
+import { FormatModules, KeyframeStride, ReadAheadStrategy, URLSourceOptions } from "./demuxer";
 
 export enum WasmWorkerMessageType {
   WasmWorkerLoaded = "WasmWorkerLoaded",
   WASMRuntimeInitialized = "WASMRuntimeInitialized",
   LoadWASM = "LoadWASM",
+  CompileWASM = "CompileWASM",
   GetAVPacket = "GetAVPacket",
   GetAVPackets = "GetAVPackets",
   GetAVStream = "GetAVStream",
   GetAVStreams = "GetAVStreams",
   GetMediaInfo = "GetMediaInfo",
   ReadAVPacket = "ReadAVPacket",
+  StartPlayback = "StartPlayback",
+  PlaybackStart = "PlaybackStart",
+  ReadKeyframePacket = "ReadKeyframePacket",
+  ReadReverseGOP = "ReadReverseGOP",
+  GOPStream = "GOPStream",
   AVPacketStream = "AVPacketStream",
   ReadNextAVPacket = "ReadNextAVPacket",
   StopReadAVPacket = "StopReadAVPacket",
   SetAVLogLevel = "SetAVLogLevel",
+  ReadSegmentPacket = "ReadSegmentPacket",
+  AppendSegment = "AppendSegment",
+  SegmentAVStreams = "SegmentAVStreams",
+  OpenSource = "OpenSource",
+  CloseSource = "CloseSource",
+  CancelRequest = "CancelRequest",
+  GetSampleTable = "GetSampleTable",
+  GetSamples = "GetSamples",
+  GetIOStats = "GetIOStats",
+  AnalyzeStream = "AnalyzeStream",
+  StartIOTrace = "StartIOTrace",
+  StopIOTrace = "StopIOTrace",
+  ProbeMany = "ProbeMany",
+  ProbeResult = "ProbeResult",
+  ExportClip = "ExportClip",
+  ExportChunk = "ExportChunk",
+  GetSchedulerStats = "GetSchedulerStats",
+  GetMemoryStats = "GetMemoryStats",
+  RecycleWASM = "RecycleWASM",
+  BuildSeekIndex = "BuildSeekIndex",
 }
 
 export type WasmWorkerMessageData =
@@ -22,55 +49,249 @@ export type WasmWorkerMessageData =
   | GetAVStreamMessageData
   | GetAVStreamsMessageData
   | ReadAVPacketMessageData
+  | StartPlaybackMessageData
+  | ReadKeyframePacketMessageData
+  | ReadReverseGOPMessageData
+  | ReadNextAVPacketMessageData
   | LoadWASMMessageData
   | SetAVLogLevelMessageData
-  | GetMediaInfoMessageData;
+  | GetMediaInfoMessageData
+  | ReadSegmentPacketMessageData
+  | AppendSegmentMessageData
+  | OpenSourceMessageData
+  | CloseSourceMessageData
+  | GetSampleTableMessageData
+  | GetSamplesMessageData
+  | GetIOStatsMessageData
+  | AnalyzeStreamMessageData
+  | IOTraceMessageData
+  | ProbeManyMessageData
+  | ExportClipMessageData
+  | BuildSeekIndexMessageData
+  | RecycleWASMMessageData;
+
+/**
+ * an opened source session id, or a File / url opened only for one request
+ */
+export type WasmWorkerSource = number | File | string;
 
 export interface GetAVStreamMessageData {
-  source: File | string;
+  source: WasmWorkerSource;
   streamType: AVMediaType;
   streamIndex: number;
 }
 
 export interface GetAVStreamsMessageData {
-  source: File | string;
+  source: WasmWorkerSource;
 }
 
 export interface GetAVPacketMessageData {
-  source: File | string;
+  source: WasmWorkerSource;
   time: number;
   streamType: AVMediaType;
   streamIndex: number;
   seekFlag: AVSeekFlag;
+  /**
+   * makes the request cancellable, the slot in cancelSignals holding the latest request id
+   */
+  cancelSlot?: number;
 }
 
 export interface GetAVPacketsMessageData {
-  source: File | string;
+  source: WasmWorkerSource;
   time: number;
   seekFlag: AVSeekFlag;
 }
 
+export interface GetSampleTableMessageData {
+  source: WasmWorkerSource;
+  streamType: AVMediaType;
+  streamIndex: number;
+}
+
+export interface GetSamplesMessageData {
+  source: WasmWorkerSource;
+  streamIndex: number;
+  first: number;
+  count: number;
+}
+
+export interface AnalyzeStreamMessageData {
+  source: WasmWorkerSource;
+  start: number;
+  end: number;
+  streamType: AVMediaType;
+  streamIndex: number;
+  bitrateBucket: number;
+}
+
 export interface ReadAVPacketMessageData {
-  source: File | string;
+  source: WasmWorkerSource;
   start: number;
   end: number;
   streamType: AVMediaType;
   streamIndex: number;
   seekFlag: AVSeekFlag;
+  readAhead?: ReadAheadStrategy;
+  /**
+   * shared ring to write packets into instead of posting them
+   */
+  packetRing?: SharedArrayBuffer;
+}
+
+export interface StartPlaybackMessageData {
+  source: WasmWorkerSource;
+  start: number;
+  end: number;
+  /**
+   * -1 for the best stream, PLAYBACK_NO_STREAM to leave it out
+   */
+  videoStreamIndex: number;
+  audioStreamIndex: number;
+  readAhead?: ReadAheadStrategy;
+  /**
+   * shared ring to write packets into instead of posting them
+   */
+  packetRing?: SharedArrayBuffer;
+}
+
+export interface ReadKeyframePacketMessageData {
+  source: WasmWorkerSource;
+  start: number;
+  end: number;
+  streamType: AVMediaType;
+  streamIndex: number;
+  stride?: KeyframeStride;
+  readAhead?: ReadAheadStrategy;
+  packetRing?: SharedArrayBuffer;
+}
+
+export interface ReadReverseGOPMessageData {
+  source: WasmWorkerSource;
+  start: number;
+  end: number;
+  streamType: AVMediaType;
+  streamIndex: number;
+  /**
+   * GOPs demuxed ahead of the consumer
+   */
+  highWaterMark: number;
+}
+
+export interface ReadNextAVPacketMessageData {
+  /**
+   * total size consumed from the read-ahead queue, in the unit of its strategy
+   */
+  consumed: number;
 }
 
 export interface LoadWASMMessageData {
   wasmFilePath?: string;
+  wasmModule?: WebAssembly.Module;
+  /**
+   * without wasmFilePath, have the main thread compile the default wasm file the worker resolved
+   */
+  shareWASMModule?: boolean;
+  /**
+   * latest request id per cancel slot, shared with the main thread when cross-origin isolated
+   */
+  cancelSignals?: Int32Array;
+  urlSource?: URLSourceOptions;
+  /**
+   * bytes the worker should stay within, 0 for no budget
+   */
+  memoryBudget?: number;
+  /**
+   * load the module of the format of the first source instead of wasmFilePath, lazily
+   */
+  formatModules?: FormatModules;
+}
+
+export interface RecycleWASMMessageData {
+  /**
+   * recycle only when the heap fragmentation is at least this share
+   */
+  minFragmentation?: number;
+}
+
+export interface WASMStartupTiming {
+  /**
+   * whether the compiled wasm module was reused from a previous instance
+   */
+  cached: boolean;
+  /**
+   * time spent compiling the shared wasm module in ms, 0 when cached or compiled inside the worker
+   */
+  compileTime: number;
+  /**
+   * time spent in the worker to instantiate (and compile, when not shared) the wasm module in ms
+   */
+  instantiateTime: number;
+  /**
+   * time from constructor to runtime initialized in ms
+   */
+  totalTime: number;
 }
 
 export interface GetMediaInfoMessageData {
-  source: File | string;
+  source: WasmWorkerSource;
 }
 
 export interface SetAVLogLevelMessageData {
   level: AVLogLevel;
 }
 
+export interface OpenSourceMessageData {
+  source: File | string;
+}
+
+export interface CloseSourceMessageData {
+  sessionId: number;
+}
+
+export interface ProbeManyMessageData {
+  sources: (File | string)[];
+}
+
+export interface GetIOStatsMessageData {
+  sessionId: number;
+}
+
+export interface IOTraceMessageData {
+  sessionId: number;
+}
+
+export interface ReadSegmentPacketMessageData {
+  format: string;
+  readAhead?: ReadAheadStrategy;
+  /**
+   * shared ring to write packets into instead of posting them
+   */
+  packetRing?: SharedArrayBuffer;
+}
+
+export interface AppendSegmentMessageData {
+  streamId: number;
+  segment: ArrayBuffer | Uint8Array | null;
+  last: boolean;
+}
+
+export interface ExportClipMessageData {
+  source: WasmWorkerSource;
+  format: string;
+  start: number;
+  end: number;
+  streamIndices: number[];
+  /**
+   * bytes posted ahead of the consumer
+   */
+  highWaterMark: number;
+}
+
+export interface BuildSeekIndexMessageData {
+  source: WasmWorkerSource;
+}
+
 export interface WasmWorkerMessage {
   type: WasmWorkerMessageType;
   data: WasmWorkerMessageData;
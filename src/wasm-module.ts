@@ -0,0 +1,56 @@
+export interface CompiledWASMModule {
+  module: Promise<WebAssembly.Module>;
+  compileTime: number;
+}
+
+/**
+ * compiled wasm modules shared by all WebDemuxer instances, keyed by wasm file path
+ */
+const compiledModules = new Map<string, CompiledWASMModule>();
+
+async function compile(wasmFilePath: string) {
+  const response = await fetch(wasmFilePath);
+
+  if (!response.ok) {
+    throw new Error(`fetch wasm failed: ${wasmFilePath}`);
+  }
+
+  // compileStreaming requires application/wasm MIME type
+  if (response.headers.get("Content-Type")?.startsWith("application/wasm")) {
+    return WebAssembly.compileStreaming(response);
+  }
+
+  return WebAssembly.compile(await response.arrayBuffer());
+}
+
+/**
+ * Get the compiled wasm module for a wasm file path, compile it once if not cached yet.
+ * @param wasmFilePath wasm file path
+ * @returns the shared compiled module entry and whether it was already cached
+ */
+export function getCompiledWASMModule(wasmFilePath: string) {
+  const cached = compiledModules.get(wasmFilePath);
+
+  if (cached) {
+    return { entry: cached, cached: true };
+  }
+
+  const startTime = performance.now();
+  const entry: CompiledWASMModule = {
+    module: compile(wasmFilePath),
+    compileTime: 0,
+  };
+
+  entry.module.then(
+    () => {
+      entry.compileTime = performance.now() - startTime;
+    },
+    () => {
+      // allow a later instance to retry
+      compiledModules.delete(wasmFilePath);
+    },
+  );
+  compiledModules.set(wasmFilePath, entry);
+
+  return { entry, cached: false };
+}
@@ -1,8 +1,44 @@
-import { WasmWorkerMessageType, GetAVPacketMessageData, GetAVPacketsMessageData, GetAVStreamMessageData, GetAVStreamsMessageData, GetMediaInfoMessageData, LoadWASMMessageData, ReadAVPacketMessageData, SetAVLogLevelMessageData, WebAVPacket, WebAVStream } from "./types";
+import { WasmWorkerMessageType, GetAVPacketMessageData, GetAVPacketsMessageData, GetAVStreamMessageData, GetAVStreamsMessageData, GetMediaInfoMessageData, LoadWASMMessageData, ReadAVPacketMessageData, StartPlaybackMessageData, ReadKeyframePacketMessageData, ReadReverseGOPMessageData, SetAVLogLevelMessageData, ReadSegmentPacketMessageData, AppendSegmentMessageData, GetSampleTableMessageData, GetSamplesMessageData, AnalyzeStreamMessageData, OpenSourceMessageData, CloseSourceMessageData, GetIOStatsMessageData, IOTraceMessageData, ProbeManyMessageData, ExportClipMessageData, BuildSeekIndexMessageData, RecycleWASMMessageData, ModuleFormat, RequestPriority, WebAVPacket, WebAVStream } from "./types";
+import { PacketRingWriter } from "./packet-ring";
+import { RangeLoader, RangeFetchEvent, isRangeLoaderSupported } from "./range-loader";
+import { budgetURLSourceOptions, MEMORY_BUDGET_SHARE } from "./memory-budget";
+import { getModuleFormatByName, getSourceModuleFormat } from "./format-modules";
+// @ts-ignore
+import RangeFetchWorker from "./range-fetch.worker.ts?worker&inline";
 // @ts-ignore
 import createModule from './lib/web-demuxer.js'
 
 let Module: any; // TODO: rm any
+let cancelSignals: Int32Array | undefined;
+const cancellableRequests = new Map<number, number>(); // request id -> cancel slot
+const cancelledRequests = new Set<number>();
+let urlSourceOptions: LoadWASMMessageData["urlSource"];
+let rangeFetchWorker: Promise<Worker> | undefined;
+let createRangeLoader: ((url: string) => RangeLoader) | undefined;
+let loadData: LoadWASMMessageData | undefined;
+// what the current module instance was loaded from, and its format, null for the full module
+let moduleLoadData: LoadWASMMessageData | undefined;
+let moduleFormat: ModuleFormat | null = null;
+let moduleSelection: Promise<void> = Promise.resolve();
+let avLogLevel: number | undefined;
+// requests started and not finished, a module instance is only recycled without any
+let runningRequests = 0;
+// messages wait for a module instance being replaced
+let moduleRecycling: Promise<void> | undefined;
+// module instance of each running segment stream, by stream id
+const segmentStreamModules = new Map<number, any>();
+// replaced module instances still serving the requests started on them, closed once none runs
+let retiredModules: any[] = [];
+
+// messages handled without a module instance, which is not loaded before the first source with per-format modules
+const MODULE_FREE_MESSAGES = new Set<string>([
+  WasmWorkerMessageType.LoadWASM,
+  WasmWorkerMessageType.CancelRequest,
+  WasmWorkerMessageType.GetSchedulerStats,
+  WasmWorkerMessageType.GetMemoryStats,
+  WasmWorkerMessageType.RecycleWASM,
+  WasmWorkerMessageType.SetAVLogLevel,
+]);
 
 self.postMessage({
   type: WasmWorkerMessageType.WasmWorkerLoaded
@@ -11,51 +47,681 @@ self.postMessage({
 self.addEventListener("message", async function (e) {
   const { type, data, msgId } = e.data
 
+  // answers getMainThreadModule, not a request
+  if (type === WasmWorkerMessageType.CompileWASM) {
+    return;
+  }
+
+  if (SUSPENDED_CALL_PROGRESS_MESSAGES.has(type)) {
+    markSuspendedCallProgress();
+  }
+
+  try {
+    // the range fetch worker must be running before the first blocking read of a url
+    if (hasURLSource(data)) {
+      await startRangeFetchWorker();
+    }
+
+    if (moduleRecycling) {
+      await moduleRecycling;
+    }
+
+    if (loadData?.formatModules && !MODULE_FREE_MESSAGES.has(type)) {
+      await selectFormatModule(type, data);
+    }
+  } catch (e) {
+    postError(type, msgId, e);
+    return;
+  }
+
+  const defaultPriority = DEFAULT_REQUEST_PRIORITY[type as WasmWorkerMessageType];
+
+  if (defaultPriority === undefined) {
+    return handleMessage(type, data, msgId);
+  }
+
+  // the priority option of the instance overrides the default of the request type
+  const priority = REQUEST_PRIORITIES.indexOf(data?.priority);
+
+  scheduleTask({
+    type,
+    msgId,
+    priority: priority >= 0 ? priority : REQUEST_PRIORITIES.indexOf(defaultPriority),
+    enqueuedAt: performance.now(),
+    run: async () => {
+      const suspending = SUSPENDING_REQUESTS.has(type);
+
+      runningRequests++;
+
+      if (suspending) {
+        suspendedCall = true;
+        markSuspendedCallProgress();
+        watchHeldTasks();
+      }
+
+      try {
+        await handleMessage(type, data, msgId);
+      } finally {
+        runningRequests--;
+
+        if (runningRequests === 0) {
+          closeRetiredModules();
+        }
+
+        // the suspending requests held back meanwhile may run now
+        if (suspending) {
+          suspendedCall = false;
+          postNextTask();
+        }
+      }
+    },
+  });
+});
+
+async function handleMessage(type: string, data: any, msgId: number) {
   try {
     switch (type) {
       case "LoadWASM":
         return await handleLoadWASM(data);
+      case "OpenSource":
+        return handleOpenSource(data, msgId);
+      case "CloseSource":
+        return handleCloseSource(data, msgId);
+      case "GetIOStats":
+        return handleGetIOStats(data, msgId);
+      case "StartIOTrace":
+        return handleStartIOTrace(data, msgId);
+      case "StopIOTrace":
+        return handleStopIOTrace(data, msgId);
       case "GetAVStream":
         return handleGetAVStream(data, msgId);
       case "GetAVStreams":
         return handleGetAVStreams(data, msgId);
       case "GetMediaInfo":
         return handleGetMediaInfo(data, msgId);
+      case "ProbeMany":
+        return handleProbeMany(data, msgId);
       case "GetAVPacket":
         return handleGetAVPacket(data, msgId);
       case "GetAVPackets":
         return handleGetAVPackets(data, msgId);
+      case "GetSampleTable":
+        return handleGetSampleTable(data, msgId);
+      case "GetSamples":
+        return handleGetSamples(data, msgId);
+      case "AnalyzeStream":
+        return await handleAnalyzeStream(data, msgId);
       case "ReadAVPacket":
         return await handleReadAVPacket(data, msgId);
+      case "StartPlayback":
+        return await handleStartPlayback(data, msgId);
+      case "ReadKeyframePacket":
+        return await handleReadKeyframePacket(data, msgId);
+      case "ReadReverseGOP":
+        return await handleReadReverseGOP(data, msgId);
+      case "CancelRequest":
+        return handleCancelRequest(msgId);
+      case "GetSchedulerStats":
+        return handleGetSchedulerStats(msgId);
+      case "GetMemoryStats":
+        return handleGetMemoryStats(msgId);
+      case "RecycleWASM":
+        return await handleRecycleWASM(data, msgId);
       case "SetAVLogLevel":
         return handleSetAVLogLevel(data, msgId);
+      case "ReadSegmentPacket":
+        return await handleReadSegmentPacket(data, msgId);
+      case "AppendSegment":
+        return handleAppendSegment(data, msgId);
+      case "ExportClip":
+        return await handleExportClip(data, msgId);
+      case "BuildSeekIndex":
+        return await handleBuildSeekIndex(data, msgId);
       default:
         return;
     }
   } catch (e) {
+    postError(type, msgId, e);
+  }
+}
+
+function postError(type: string, msgId: number, e: unknown) {
+  self.postMessage({
+    type,
+    msgId,
+    errMsg: e instanceof Error ? e.message : "Unknown Error",
+  });
+}
+
+// ============ request scheduler ============
+const REQUEST_PRIORITIES: RequestPriority[] = ["interactive", "playback", "background"];
+
+// requests that demux are run by priority, other messages as they arrive
+const DEFAULT_REQUEST_PRIORITY: Partial<Record<WasmWorkerMessageType, RequestPriority>> = {
+  [WasmWorkerMessageType.GetAVStream]: "interactive",
+  [WasmWorkerMessageType.GetAVStreams]: "interactive",
+  [WasmWorkerMessageType.GetMediaInfo]: "interactive",
+  [WasmWorkerMessageType.GetAVPacket]: "interactive",
+  [WasmWorkerMessageType.GetAVPackets]: "interactive",
+  [WasmWorkerMessageType.GetSampleTable]: "interactive",
+  [WasmWorkerMessageType.GetSamples]: "interactive",
+  [WasmWorkerMessageType.ReadAVPacket]: "playback",
+  [WasmWorkerMessageType.StartPlayback]: "playback",
+  [WasmWorkerMessageType.ReadKeyframePacket]: "playback",
+  [WasmWorkerMessageType.ReadReverseGOP]: "playback",
+  [WasmWorkerMessageType.ReadSegmentPacket]: "playback",
+  [WasmWorkerMessageType.AnalyzeStream]: "background",
+  [WasmWorkerMessageType.ProbeMany]: "background",
+  [WasmWorkerMessageType.ExportClip]: "background",
+  [WasmWorkerMessageType.BuildSeekIndex]: "background",
+};
+
+// a long read gives way to other requests after running this long, in ms
+const SLICE_TIME = 8;
+
+/**
+ * requests whose wasm call suspends (ASYNCIFY) for its next slice, read-ahead credit or
+ * segment data. ASYNCIFY keeps the unwound stack of a single suspended call per module
+ * instance, so while one is suspended only requests returning without suspending may run.
+ */
+const SUSPENDING_REQUESTS = new Set<string>([
+  WasmWorkerMessageType.ReadAVPacket,
+  WasmWorkerMessageType.StartPlayback,
+  WasmWorkerMessageType.ReadKeyframePacket,
+  WasmWorkerMessageType.ReadReverseGOP,
+  WasmWorkerMessageType.ReadSegmentPacket,
+  WasmWorkerMessageType.AnalyzeStream,
+  WasmWorkerMessageType.ExportClip,
+  WasmWorkerMessageType.BuildSeekIndex,
+]);
+
+interface ScheduledTask {
+  priority: number;
+  enqueuedAt: number;
+  run: () => unknown;
+  /**
+   * set for requests, unset for the next slice of a running read
+   */
+  type?: string;
+  msgId?: number;
+}
+
+const taskQueues: ScheduledTask[][] = REQUEST_PRIORITIES.map(() => []);
+const queueStats = REQUEST_PRIORITIES.map(() => ({ requests: 0, totalWaitTime: 0, maxWaitTime: 0, slices: 0 }));
+const schedulerChannel = new MessageChannel();
+let currentPriority = 1;
+let nextTaskPosted = false;
+// a suspending request is running, from its start until its wasm call returns
+let suspendedCall = false;
+// the held-back requests fail once the suspended call made no progress for this long,
+// e.g. a stream nobody reads or a segment stream waiting for data
+const SUSPENDED_CALL_STALL_TIMEOUT = 5000;
+// messages that let a suspended call go on
+const SUSPENDED_CALL_PROGRESS_MESSAGES = new Set<string>([
+  WasmWorkerMessageType.ReadNextAVPacket,
+  WasmWorkerMessageType.StopReadAVPacket,
+  WasmWorkerMessageType.AppendSegment,
+  WasmWorkerMessageType.CancelRequest,
+]);
+let suspendedCallProgress = 0;
+let stallTimer: ReturnType<typeof setTimeout> | undefined;
+
+// one task per turn of the event loop, so messages arriving meanwhile are queued by priority first
+schedulerChannel.port1.onmessage = runNextTask;
+
+function scheduleTask(task: ScheduledTask) {
+  taskQueues[task.priority].push(task);
+  postNextTask();
+  watchHeldTasks();
+}
+
+function markSuspendedCallProgress() {
+  suspendedCallProgress = performance.now();
+}
+
+// checks the held-back requests once the suspended call may have stalled
+function watchHeldTasks() {
+  if (stallTimer !== undefined || !suspendedCall || taskQueues.every((queue) => queue.every(isRunnable))) {
+    return;
+  }
+
+  stallTimer = setTimeout(() => {
+    stallTimer = undefined;
+
+    if (suspendedCall && performance.now() - suspendedCallProgress >= SUSPENDED_CALL_STALL_TIMEOUT) {
+      rejectHeldTasks();
+    }
+    watchHeldTasks();
+  }, Math.max(0, suspendedCallProgress + SUSPENDED_CALL_STALL_TIMEOUT - performance.now()));
+}
+
+function rejectHeldTasks() {
+  for (const queue of taskQueues) {
+    for (const task of queue.filter((task) => !isRunnable(task))) {
+      queue.splice(queue.indexOf(task), 1);
+      postError(task.type!, task.msgId!, new Error(
+        "Another read on this worker is suspended waiting for its consumer, read or cancel that stream first"
+      ));
+    }
+  }
+}
+
+function postNextTask() {
+  if (!nextTaskPosted && taskQueues.some((queue) => queue.some(isRunnable))) {
+    nextTaskPosted = true;
+    schedulerChannel.port2.postMessage(null);
+  }
+}
+
+// slices of the suspended call and requests not suspending run any time
+function isRunnable(task: ScheduledTask) {
+  return !suspendedCall || task.type === undefined || !SUSPENDING_REQUESTS.has(task.type);
+}
+
+function runNextTask() {
+  nextTaskPosted = false;
+
+  const priority = taskQueues.findIndex((queue) => queue.some(isRunnable));
+
+  if (priority < 0) return;
+
+  const index = taskQueues[priority].findIndex(isRunnable);
+  const [task] = taskQueues[priority].splice(index, 1);
+  const waitTime = performance.now() - task.enqueuedAt;
+  const stats = queueStats[priority];
+
+  if (task.msgId !== undefined) {
+    stats.requests++;
+    stats.totalWaitTime += waitTime;
+    stats.maxWaitTime = Math.max(stats.maxWaitTime, waitTime);
+  } else {
+    stats.slices++;
+    markSuspendedCallProgress();
+  }
+
+  // runs until the first await of the task, senders created meanwhile take its priority
+  currentPriority = priority;
+  task.run();
+  postNextTask();
+}
+
+const requestScheduler = {
+  currentPriority: () => currentPriority,
+  // messages arriving while a slice runs are only seen once it gives the event loop back,
+  // so every slice ends after SLICE_TIME and resumes after the requests queued by then
+  shouldYield: (sliceStart: number) => performance.now() - sliceStart >= SLICE_TIME,
+  nextSlice: (priority: number) => new Promise<void>((resolve) => {
+    scheduleTask({ priority, enqueuedAt: performance.now(), run: resolve });
+  }),
+};
+
+// a request still waiting for its turn is dropped at once
+function cancelScheduledTask(msgId: number) {
+  for (const queue of taskQueues) {
+    const index = queue.findIndex((task) => task.msgId === msgId);
+
+    if (index >= 0) {
+      const [task] = queue.splice(index, 1);
+
+      postError(task.type!, msgId, new Error("Request cancelled"));
+      return true;
+    }
+  }
+
+  return false;
+}
+
+function handleGetSchedulerStats(msgId: number) {
+  const result = Object.fromEntries(REQUEST_PRIORITIES.map((priority, index) => {
+    const { requests, totalWaitTime, maxWaitTime, slices } = queueStats[index];
+
+    return [priority, {
+      requests,
+      avgWaitTime: requests > 0 ? totalWaitTime / requests : 0,
+      maxWaitTime,
+      slices,
+      queued: taskQueues[index].length,
+    }];
+  }));
+
+  self.postMessage({
+    type: WasmWorkerMessageType.GetSchedulerStats,
+    msgId,
+    result,
+  });
+}
+
+async function handleLoadWASM(data: LoadWASMMessageData) {
+  const startTime = performance.now();
+
+  loadData = data;
+  cancelSignals = data?.cancelSignals;
+  urlSourceOptions = budgetURLSourceOptions(data?.urlSource, data?.memoryBudget);
+
+  // nothing to instantiate before the first source picks the module
+  if (data?.formatModules) {
     self.postMessage({
-      type,
-      msgId,
-      errMsg: e instanceof Error ? e.message : "Unknown Error",
+      type: WasmWorkerMessageType.WASMRuntimeInitialized,
+      result: {
+        instantiateTime: 0,
+      },
     });
+    return;
   }
-});
 
-async function handleLoadWASM(data: LoadWASMMessageData) {
-  const { wasmFilePath } = data || {};
+  Module = await instantiateModule(data, () => {
+    self.postMessage({
+      type: WasmWorkerMessageType.WASMRuntimeInitialized,
+      result: {
+        instantiateTime: performance.now() - startTime,
+      },
+    });
+  });
+}
+
+/**
+ * the default wasm file compiled on the main thread, once for all workers, undefined when it failed
+ */
+function getMainThreadModule(wasmFilePath: string) {
+  return new Promise<WebAssembly.Module | undefined>((resolve) => {
+    const listener = ({ data }: MessageEvent) => {
+      if (data.type !== WasmWorkerMessageType.CompileWASM) return;
 
-  Module = await createModule({
-    locateFile:(path: string, prefix: string) => {
-      if (path.endsWith('.wasm') && wasmFilePath) {
-        return wasmFilePath;
+      self.removeEventListener("message", listener);
+      resolve(data.data?.wasmModule);
+    };
+
+    self.addEventListener("message", listener);
+    self.postMessage({
+      type: WasmWorkerMessageType.CompileWASM,
+      result: { wasmFilePath },
+    });
+  });
+}
+
+/**
+ * a new instance of the wasm module, with the worker callbacks and the memory budget set
+ */
+function instantiateModule(data: LoadWASMMessageData | undefined, onRuntimeInitialized?: () => void) {
+  const { wasmFilePath, wasmModule, memoryBudget, shareWASMModule } = data || {};
+  // the default wasm file is only known here, by the path locateFile gets
+  let defaultWasmFilePath = '';
+
+  moduleLoadData = data;
+
+  return new Promise<any>((resolve, reject) => {
+    createModule({
+      locateFile:(path: string, prefix: string) => {
+        if (path.endsWith('.wasm') && wasmFilePath) {
+          return wasmFilePath;
+        }
+
+        if (path.endsWith('.wasm')) {
+          defaultWasmFilePath = prefix + path;
+        }
+
+        return prefix + path;
+      },
+      // instantiate only, when the module has already been compiled on the main thread
+      instantiateWasm: wasmModule || (shareWASMModule && !wasmFilePath) ? (
+        imports: WebAssembly.Imports,
+        receiveInstance: (instance: WebAssembly.Instance, module: WebAssembly.Module) => void
+      ) => {
+        (wasmModule ? Promise.resolve(wasmModule) : getMainThreadModule(defaultWasmFilePath)).then(async (module) => {
+          if (module) {
+            receiveInstance(await WebAssembly.instantiate(module, imports), module);
+            return;
+          }
+
+          // fallback to compiling here if the shared compile failed
+          const response = await fetch(defaultWasmFilePath);
+          const result = await WebAssembly.instantiate(await response.arrayBuffer(), imports);
+
+          receiveInstance(result.instance, result.module);
+        }).catch(reject);
+
+        return {};
+      } : undefined,
+      onRuntimeInitialized,
+    }).then((instance: any) => {
+      instance.isRequestCancelled = isRequestCancelled;
+      instance.requestScheduler = requestScheduler;
+      instance.urlSourceOptions = urlSourceOptions;
+      instance.createRangeLoader = createRangeLoader;
+      instance.memoryBudgetShare = MEMORY_BUDGET_SHARE;
+      instance.setMemoryBudget(memoryBudget ?? 0);
+
+      if (avLogLevel !== undefined) {
+        instance.setAVLogLevel(avLogLevel);
       }
 
-      return prefix + path;
-    },
-    onRuntimeInitialized: () => {
-      self.postMessage({ type: WasmWorkerMessageType.WASMRuntimeInitialized });
+      resolve(instance);
+    }, reject);
+  });
+}
+
+/**
+ * Replace the module instance by a new one to give its wasm memory back, which never
+ * shrinks, when heap fragmentation reached minFragmentation. Open sources are reopened
+ * under the same session ids, their I/O stats start over.
+ */
+async function handleRecycleWASM(data: RecycleWASMMessageData, msgId: number) {
+  const { minFragmentation = 0 } = data || {};
+  let result = false;
+
+  if (Module && Module.getMemoryStats().fragmentation >= minFragmentation) {
+    await replaceModule(moduleLoadData);
+    result = true;
+  }
+
+  self.postMessage({
+    type: WasmWorkerMessageType.RecycleWASM,
+    msgId,
+    result,
+  });
+}
+
+/**
+ * a new module instance from data in place of the current one, with the open sources reopened.
+ * With keepBusyModule, requests running meanwhile finish on the old instance, later ones
+ * run on the new one, otherwise the old instance must be idle to be given back.
+ */
+async function replaceModule(data: LoadWASMMessageData | undefined, keepBusyModule = false) {
+  // requests still queued would start on the old instance meanwhile
+  if (!keepBusyModule && (runningRequests > 0 || taskQueues.some((queue) => queue.length > 0))) {
+    throw new Error("Cannot replace the wasm module while requests are running");
+  }
+
+  moduleRecycling = instantiateModule(data).then((instance) => {
+    const sources: [number, File | string | (File | string)[]][] = Module.getOpenSources();
+
+    for (const [sessionId, source] of sources) {
+      instance.openSource(source, sessionId);
     }
-  })
+
+    if (runningRequests > 0) {
+      retiredModules.push(Module);
+    } else {
+      // close the range loaders of the old instance as well
+      closeModuleSources(Module);
+    }
+    Module = instance;
+  });
+
+  try {
+    await moduleRecycling;
+  } finally {
+    moduleRecycling = undefined;
+  }
+}
+
+function closeModuleSources(instance: any) {
+  for (const [sessionId] of instance.getOpenSources()) {
+    instance.closeSource(sessionId);
+  }
+}
+
+function closeRetiredModules() {
+  retiredModules.forEach(closeModuleSources);
+  retiredModules = [];
+}
+
+/**
+ * With per-format modules, no module is loaded upfront: the first request loads the module
+ * of the format of its source, or the full module for other formats, and a request the
+ * loaded per-format module cannot serve replaces it by the full module, also while
+ * requests are running on it.
+ */
+function selectFormatModule(type: string, data: any) {
+  // the full module serves every request
+  if (Module && moduleFormat === null) {
+    return;
+  }
+
+  const requiredFormats = getRequiredFormats(type, data);
+
+  // one selection at a time, in message order
+  moduleSelection = moduleSelection.catch(() => {}).then(async () => {
+    const formats = await requiredFormats;
+
+    if (Module && (moduleFormat === null || formats.every((format) => format === moduleFormat))) {
+      return;
+    }
+
+    const format = !Module && formats.length > 0 && formats.every((format) => format === formats[0])
+      ? formats[0]
+      : null;
+    const formatFilePath = format && loadData!.formatModules![format];
+    const data = formatFilePath ? { ...loadData, wasmFilePath: formatFilePath } : loadData;
+
+    if (Module) {
+      // the running requests of another format finish on the per-format module
+      await replaceModule(data, true);
+    } else {
+      Module = await instantiateModule(data);
+    }
+    moduleFormat = formatFilePath ? format : null;
+  });
+
+  return moduleSelection;
+}
+
+// formats of the sources and output of a request, none when any module instance serves it
+async function getRequiredFormats(type: string, data: any): Promise<(ModuleFormat | null)[]> {
+  if (type === WasmWorkerMessageType.ReadSegmentPacket) {
+    return [getModuleFormatByName(data.format)];
+  }
+
+  const sources: (File | string)[] = [data?.source, ...(data?.sources ?? [])]
+    .flat()
+    .filter((source) => source instanceof File || typeof source === "string");
+  const formats = await Promise.all(sources.map(getSourceModuleFormat));
+
+  if (type === WasmWorkerMessageType.ExportClip) {
+    formats.push(getModuleFormatByName(data.format));
+  }
+
+  return formats;
+}
+
+function handleGetMemoryStats(msgId: number) {
+  const result = Module
+    ? Module.getMemoryStats()
+    : { heapSize: 0, heapUsed: 0, fragmentation: 0, memoryBudget: loadData?.memoryBudget ?? 0 };
+
+  self.postMessage({
+    type: WasmWorkerMessageType.GetMemoryStats,
+    msgId,
+    result,
+  });
+}
+
+function hasURLSource(data: any) {
+  return typeof data?.source === "string" ||
+    (Array.isArray(data?.sources) && data.sources.some((source: unknown) => typeof source === "string"));
+}
+
+/**
+ * url sources are read by parallel range requests on a nested worker when shared memory
+ * is available, otherwise post.js falls back to one blocking request per read
+ */
+function startRangeFetchWorker() {
+  if (!rangeFetchWorker && isRangeLoaderSupported()) {
+    rangeFetchWorker = new Promise((resolve) => {
+      const worker: Worker = new RangeFetchWorker({ name: "web-demuxer-range-fetch" });
+
+      worker.addEventListener("message", (e: MessageEvent<RangeFetchEvent>) => {
+        const event = e.data;
+
+        if (event.type === "ready") {
+          createRangeLoader = (url: string) => new RangeLoader(worker, url, urlSourceOptions);
+
+          // set on module instances created later when instantiating them
+          if (Module) {
+            Module.createRangeLoader = createRangeLoader;
+          }
+          resolve(worker);
+        } else if (event.type === "timing") {
+          RangeLoader.addRequestTiming(event.id, event.timing);
+        }
+      });
+    });
+  }
+
+  return rangeFetchWorker;
+}
+
+function handleOpenSource(data: OpenSourceMessageData, msgId: number) {
+  const { source } = data;
+  const result = Module.openSource(source);
+
+  self.postMessage({
+    type: WasmWorkerMessageType.OpenSource,
+    msgId,
+    result,
+  });
+}
+
+function handleCloseSource(data: CloseSourceMessageData, msgId: number) {
+  const { sessionId } = data;
+
+  Module.closeSource(sessionId);
+  self.postMessage({
+    type: WasmWorkerMessageType.CloseSource,
+    msgId,
+  });
+}
+
+function handleGetIOStats(data: GetIOStatsMessageData, msgId: number) {
+  const { sessionId } = data;
+  const result = Module.getIOStats(sessionId);
+
+  self.postMessage({
+    type: WasmWorkerMessageType.GetIOStats,
+    msgId,
+    result,
+  });
+}
+
+function handleStartIOTrace(data: IOTraceMessageData, msgId: number) {
+  const { sessionId } = data;
+
+  Module.startIOTrace(sessionId);
+  self.postMessage({
+    type: WasmWorkerMessageType.StartIOTrace,
+    msgId,
+  });
+}
+
+function handleStopIOTrace(data: IOTraceMessageData, msgId: number) {
+  const { sessionId } = data;
+  const result = Module.stopIOTrace(sessionId);
+
+  self.postMessage({
+    type: WasmWorkerMessageType.StopIOTrace,
+    msgId,
+    result,
+  });
 }
 
 function handleGetAVStream(data: GetAVStreamMessageData, msgId: number) {
@@ -100,9 +766,61 @@ function handleGetMediaInfo(data: GetMediaInfoMessageData, msgId: number) {
   );
 }
 
+function handleProbeMany(data: ProbeManyMessageData, msgId: number) {
+  const { sources } = data;
+  // results are posted one by one as ProbeResult messages
+  const result = Module.probeMany(msgId, sources);
+
+  self.postMessage({
+    type: WasmWorkerMessageType.ProbeMany,
+    msgId,
+    result,
+  });
+}
+
+/**
+ * a cancellable request is cancelled by a CancelRequest message, or as soon as
+ * a newer request id is stored in its shared cancel slot
+ */
+function isRequestCancelled(requestId: number) {
+  const cancelSlot = cancellableRequests.get(requestId);
+
+  if (cancelSlot === undefined) {
+    return false;
+  }
+
+  return cancelledRequests.has(requestId) ||
+    (!!cancelSignals && Atomics.load(cancelSignals, cancelSlot) !== requestId);
+}
+
+function handleCancelRequest(msgId: number) {
+  if (cancelScheduledTask(msgId)) return;
+
+  if (cancellableRequests.has(msgId)) {
+    cancelledRequests.add(msgId);
+  }
+}
+
 function handleGetAVPacket(data: GetAVPacketMessageData, msgId: number) {
-  const { source, time, streamType, streamIndex, seekFlag } = data;
-  const result = Module.getAVPacket(source, time, streamType, streamIndex, seekFlag);
+  const { source, time, streamType, streamIndex, seekFlag, cancelSlot } = data;
+  let result;
+
+  if (cancelSlot !== undefined) {
+    cancellableRequests.set(msgId, cancelSlot);
+
+    // drop superseded requests before doing any work
+    if (isRequestCancelled(msgId)) {
+      cancellableRequests.delete(msgId);
+      throw new Error("Request cancelled");
+    }
+  }
+
+  try {
+    result = Module.getAVPacket(source, time, streamType, streamIndex, seekFlag, cancelSlot !== undefined ? msgId : -1);
+  } finally {
+    cancellableRequests.delete(msgId);
+    cancelledRequests.delete(msgId);
+  }
 
   self.postMessage(
     {
@@ -128,8 +846,47 @@ function handleGetAVPackets(data: GetAVPacketsMessageData, msgId: number) {
   );
 }
 
+function handleGetSampleTable(data: GetSampleTableMessageData, msgId: number) {
+  const { source, streamType, streamIndex } = data;
+  const result = Module.getSampleTable(source, streamType, streamIndex);
+
+  self.postMessage(
+    {
+      type: WasmWorkerMessageType.GetSampleTable,
+      msgId,
+      result,
+    },
+    [result.timestamps.buffer, result.offsets.buffer, result.sizes.buffer, result.keyframes.buffer],
+  );
+}
+
+function handleGetSamples(data: GetSamplesMessageData, msgId: number) {
+  const { source, streamIndex, first, count } = data;
+  const result = Module.getSamples(source, streamIndex, first, count);
+
+  self.postMessage(
+    {
+      type: WasmWorkerMessageType.GetSamples,
+      msgId,
+      result,
+    },
+    result.map((packet: WebAVPacket) => packet.data.buffer),
+  );
+}
+
+async function handleAnalyzeStream(data: AnalyzeStreamMessageData, msgId: number) {
+  const { source, start, end, streamType, streamIndex, bitrateBucket } = data;
+  const result = await Module.analyzeStream(source, start, end, streamType, streamIndex, bitrateBucket);
+
+  self.postMessage({
+    type: WasmWorkerMessageType.AnalyzeStream,
+    msgId,
+    result,
+  });
+}
+
 async function handleReadAVPacket(data: ReadAVPacketMessageData, msgId: number) {
-  const { source, start, end, streamType, streamIndex, seekFlag } = data;
+  const { source, start, end, streamType, streamIndex, seekFlag, readAhead, packetRing } = data;
   const result = await Module.readAVPacket(
     msgId,
     source,
@@ -137,7 +894,9 @@ async function handleReadAVPacket(data: ReadAVPacketMessageData, msgId: number)
     end,
     streamType,
     streamIndex,
-    seekFlag
+    seekFlag,
+    readAhead,
+    packetRing && new PacketRingWriter(packetRing)
   );
 
   self.postMessage({
@@ -147,12 +906,119 @@ async function handleReadAVPacket(data: ReadAVPacketMessageData, msgId: number)
   });
 }
 
+async function handleStartPlayback(data: StartPlaybackMessageData, msgId: number) {
+  const { source, start, end, videoStreamIndex, audioStreamIndex, readAhead, packetRing } = data;
+  const result = await Module.startPlayback(
+    msgId,
+    source,
+    start,
+    end,
+    videoStreamIndex,
+    audioStreamIndex,
+    readAhead,
+    packetRing && new PacketRingWriter(packetRing)
+  );
+
+  self.postMessage({
+    type: WasmWorkerMessageType.StartPlayback,
+    msgId,
+    result,
+  });
+}
+
+async function handleReadKeyframePacket(data: ReadKeyframePacketMessageData, msgId: number) {
+  const { source, start, end, streamType, streamIndex, stride, readAhead, packetRing } = data;
+  const result = await Module.readKeyframePacket(
+    msgId,
+    source,
+    start,
+    end,
+    streamType,
+    streamIndex,
+    stride?.every,
+    stride?.minInterval,
+    readAhead,
+    packetRing && new PacketRingWriter(packetRing)
+  );
+
+  self.postMessage({
+    type: WasmWorkerMessageType.ReadKeyframePacket,
+    msgId,
+    result,
+  });
+}
+
+async function handleReadReverseGOP(data: ReadReverseGOPMessageData, msgId: number) {
+  const { source, start, end, streamType, streamIndex, highWaterMark } = data;
+  const result = await Module.readReverseGOP(msgId, source, start, end, streamType, streamIndex, highWaterMark);
+
+  self.postMessage({
+    type: WasmWorkerMessageType.ReadReverseGOP,
+    msgId,
+    result,
+  });
+}
+
 function handleSetAVLogLevel(data: SetAVLogLevelMessageData, msgId: number) {
   const { level } = data
 
-  Module.setAVLogLevel(level);
+  // applied again to a recycled module instance
+  avLogLevel = level;
+  Module?.setAVLogLevel(level);
   self.postMessage({
     type: "SetAVLogLevel",
     msgId,
   })
-}
\ No newline at end of file
+}
+
+async function handleReadSegmentPacket(data: ReadSegmentPacketMessageData, msgId: number) {
+  const { format, readAhead, packetRing } = data;
+  const instance = Module;
+
+  segmentStreamModules.set(msgId, instance);
+
+  const result = await instance.readSegmentPacket(
+    msgId,
+    format,
+    readAhead,
+    packetRing && new PacketRingWriter(packetRing)
+  ).finally(() => segmentStreamModules.delete(msgId));
+
+  self.postMessage({
+    type: WasmWorkerMessageType.ReadSegmentPacket,
+    msgId,
+    result,
+  });
+}
+
+function handleAppendSegment(data: AppendSegmentMessageData, msgId: number) {
+  const { streamId, segment, last } = data;
+
+  // a stream keeps the module instance it started on when the module is replaced meanwhile
+  (segmentStreamModules.get(streamId) ?? Module).appendSegment(streamId, segment, last);
+  self.postMessage({
+    type: WasmWorkerMessageType.AppendSegment,
+    msgId,
+  });
+}
+
+async function handleExportClip(data: ExportClipMessageData, msgId: number) {
+  const { source, format, start, end, streamIndices, highWaterMark } = data;
+  const result = await Module.exportClip(msgId, source, format, start, end, streamIndices, highWaterMark);
+
+  self.postMessage({
+    type: WasmWorkerMessageType.ExportClip,
+    msgId,
+    result,
+  });
+}
+
+async function handleBuildSeekIndex(data: BuildSeekIndexMessageData, msgId: number) {
+  const result = await Module.buildSeekIndex(data.source);
+
+  self.postMessage({
+    type: WasmWorkerMessageType.BuildSeekIndex,
+    msgId,
+    result,
+  });
+}
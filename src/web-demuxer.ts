@@ -13,16 +13,230 @@ import {
   MediaTypeToConfig,
   MediaTypes,
   MEDIA_TYPE_TO_AVMEDIA_TYPE,
+  WASMStartupTiming,
+  GetAVPacketMessageData,
+  ReadAVPacketMessageData,
+  StartPlaybackMessageData,
+  ReadKeyframePacketMessageData,
+  ReadSegmentPacketMessageData,
+  ReadAheadStrategy,
+  KeyframeStride,
+  PlaybackOptions,
+  WebAVPlayback,
+  WebCodecsPlayback,
+  WebSampleTable,
+  WebIOStats,
+  WebStreamAnalysis,
+  WebProbeResult,
+  URLSourceOptions,
+  RequestPriority,
+  WebSchedulerStats,
+  WebMemoryStats,
+  FormatModules,
 } from "./types";
+import { getCompiledWASMModule } from "./wasm-module";
+import { budgetSize } from "./memory-budget";
+import { PacketRingReader, OUT_OF_BAND_PACKET, createPacketRing, isPacketRingSupported } from "./packet-ring";
 import WasmWorker from "./wasm.worker.ts?worker&inline";
 
 const TIME_BASE = 1e6;
 
+/**
+ * stream index leaving a stream out of startPlayback, sync with PLAYBACK_NO_STREAM in web_demuxer.cpp
+ */
+const PLAYBACK_NO_STREAM = -2;
+
+/**
+ * size of a packet in read-ahead units, sync with getReadAheadSize in post.js
+ */
+const READ_AHEAD_SIZE: Record<NonNullable<ReadAheadStrategy["unit"]>, (packet: WebAVPacket) => number> = {
+  packets: () => 1,
+  bytes: (packet) => packet.data.byteLength,
+  seconds: (packet) => Math.max(packet.duration, 0),
+};
+
 export interface WebDemuxerOptions {
   /**
    * custom wasm file path
    */
   wasmFilePath?: string;
+  /**
+   * compile the wasm file once on the main thread and share the compiled module
+   * with every instance using the same wasmFilePath or the default one, default is true
+   */
+  shareWASMModule?: boolean;
+  /**
+   * share one worker and wasm module instance with every other instance using
+   * the same wasmFilePath and shareWorker option, each instance keeps its own
+   * source open in the worker and requests are interleaved, default is false
+   */
+  shareWorker?: boolean;
+  /**
+   * priority of every request of this instance in its worker, e.g. "background" for an
+   * export instance sharing the worker of a player, default is by request type:
+   * seeks and media info are interactive, packet streams playback, export and analysis background
+   */
+  priority?: RequestPriority;
+  /**
+   * byte size of a SharedArrayBuffer ring used by each packet stream instead of a message
+   * per packet, only when cross-origin isolated, default is 0 (disabled)
+   */
+  packetRingSize?: number;
+  /**
+   * how url sources are read, by parallel range requests streamed into shared memory
+   * when cross-origin isolated, otherwise by one blocking request per read
+   */
+  urlSource?: URLSourceOptions;
+  /**
+   * bytes the worker should stay within, e.g. on low-end mobile devices: the probe size,
+   * AVIO buffers, url source caches, packet rings and byte read-ahead are scaled down to it.
+   * The wasm heap never shrinks, see recycle() to give it back. Default is 0 (no budget)
+   */
+  memoryBudget?: number;
+  /**
+   * wasm file paths of per-format builds, e.g. `{ mp4: "web-demuxer-mp4.wasm" }`: no wasm is
+   * loaded before the first source, whose first bytes pick the module of its format, other
+   * formats load wasmFilePath. Smaller to download and compile for the common formats
+   */
+  formatModules?: FormatModules;
+}
+
+export interface ProbeManyOptions {
+  /**
+   * number of workers probing in parallel, default is min(4, hardwareConcurrency)
+   */
+  concurrency?: number;
+  /**
+   * sources mounted and probed together per worker request, default is 16
+   */
+  batchSize?: number;
+  /**
+   * custom wasm file path, compiled once for all workers
+   */
+  wasmFilePath?: string;
+}
+
+interface WasmWorkerInstance {
+  worker: Worker;
+  loadStatus: Promise<void>;
+  startupTiming?: WASMStartupTiming;
+  refCount: number;
+  /**
+   * latest scrub request id per instance, lets the worker abort superseded requests in flight
+   */
+  cancelSignals?: Int32Array;
+  cancelSlotCounter: number;
+}
+
+interface ScrubRequest {
+  data: Omit<GetAVPacketMessageData, "source">;
+  resolve: (packet: WebAVPacket) => void;
+  reject: (reason: unknown) => void;
+}
+
+interface WorkerStreamOptions<T> {
+  msgId?: number;
+  /**
+   * error the stream when no source is loaded, default is true
+   */
+  requireSource?: boolean;
+  /**
+   * shared ring the worker writes items into instead of posting them, items too large for
+   * it are still posted, the stream closes once the ring is drained
+   */
+  ring?: {
+    buffer: SharedArrayBuffer;
+    receive: (item: T) => void;
+    pull: (controller: ReadableStreamDefaultController<T>) => Promise<void>;
+    stop: () => void;
+  };
+}
+
+const MAX_CANCEL_SLOTS = 256;
+
+const sharedWasmWorkers = new Map<string, WasmWorkerInstance>();
+
+// message ids are unique across instances, so instances can share a worker
+let msgIdCounter = 0;
+
+function nextMsgId() {
+  return msgIdCounter++;
+}
+
+function createWasmWorker(options?: WebDemuxerOptions): WasmWorkerInstance {
+  const startTime = performance.now();
+  const wasmFilePath = options?.wasmFilePath;
+  const shareWASMModule = options?.shareWASMModule !== false;
+  // start compiling in parallel with the worker startup, unless the first source picks the module,
+  // the default wasm file is compiled once the worker resolved its path
+  let sharedModule = wasmFilePath && shareWASMModule && !options?.formatModules
+    ? getCompiledWASMModule(wasmFilePath)
+    : undefined;
+  const worker: Worker = new WasmWorker({
+    name: 'web-demuxer'
+  });
+  const instance: WasmWorkerInstance = {
+    worker,
+    loadStatus: Promise.resolve(),
+    refCount: 0,
+    // SharedArrayBuffer is only available when cross-origin isolated
+    cancelSignals: typeof SharedArrayBuffer !== "undefined" && self.crossOriginIsolated
+      ? new Int32Array(new SharedArrayBuffer(MAX_CANCEL_SLOTS * Int32Array.BYTES_PER_ELEMENT)).fill(-1)
+      : undefined,
+    cancelSlotCounter: 0,
+  };
+
+  instance.loadStatus = new Promise((resolve, reject) => {
+    worker.addEventListener("message", async (e) => {
+      const { type, errMsg, result } = e.data;
+
+      if (type === WasmWorkerMessageType.WasmWorkerLoaded) {
+        // fallback to compiling inside the worker if the shared compile failed
+        const wasmModule = await sharedModule?.entry.module.catch(() => undefined);
+
+        worker.postMessage({
+          type: WasmWorkerMessageType.LoadWASM,
+          msgId: nextMsgId(),
+          data: {
+            wasmFilePath,
+            wasmModule,
+            shareWASMModule,
+            cancelSignals: instance.cancelSignals,
+            urlSource: options?.urlSource,
+            memoryBudget: options?.memoryBudget,
+            formatModules: options?.formatModules,
+          },
+        });
+      }
+
+      if (type === WasmWorkerMessageType.CompileWASM) {
+        // the same url the worker fetches, relative to the page when emscripten found no script directory
+        sharedModule = getCompiledWASMModule(new URL(result.wasmFilePath, location.href).href);
+
+        worker.postMessage({
+          type: WasmWorkerMessageType.CompileWASM,
+          msgId: nextMsgId(),
+          data: { wasmModule: await sharedModule.entry.module.catch(() => undefined) },
+        });
+      }
+
+      if (type === WasmWorkerMessageType.WASMRuntimeInitialized) {
+        instance.startupTiming = {
+          cached: !!sharedModule?.cached,
+          compileTime: sharedModule && !sharedModule.cached ? sharedModule.entry.compileTime : 0,
+          instantiateTime: result.instantiateTime,
+          totalTime: performance.now() - startTime,
+        };
+        resolve();
+      }
+
+      if (type === WasmWorkerMessageType.LoadWASM && errMsg) {
+        reject(errMsg);
+      }
+    });
+  });
+
+  return instance;
 }
 
 /**
@@ -38,59 +252,72 @@ export interface WebDemuxerOptions {
  * ```
  */
 export class WebDemuxer {
+  private wasmWorkerInstance: WasmWorkerInstance;
   private wasmWorker: Worker;
   private wasmWorkerLoadStatus: Promise<void>;
-  private msgId: number;
+  private sharedWorkerKey?: string;
+  private sessionId?: number;
+  private segmentStreamId?: number;
+  private segmentStreams?: Promise<WebAVStream[]>;
+  private cancelSlot: number;
+  private scrubInFlight?: { msgId: number; reject: (reason: unknown) => void; cancelled?: boolean };
+  private scrubPending?: ScrubRequest;
+  private packetRingSize: number;
+  private priority?: RequestPriority;
+  private memoryBudget: number;
 
   public source?: File | string;
 
   constructor(options?: WebDemuxerOptions) {
-    this.wasmWorker = new WasmWorker({
-      name: 'web-demuxer'
-    });
-    this.wasmWorkerLoadStatus = new Promise((resolve, reject) => {
-      this.wasmWorker.addEventListener("message", (e) => {
-        const { type, errMsg } = e.data;
+    if (options?.shareWorker) {
+      this.sharedWorkerKey = options.wasmFilePath ?? "";
 
-        if (type === WasmWorkerMessageType.WasmWorkerLoaded) {
-          this.post(WasmWorkerMessageType.LoadWASM, {
-            wasmFilePath: options?.wasmFilePath,
-          });
-        }
+      let instance = sharedWasmWorkers.get(this.sharedWorkerKey);
 
-        if (type === WasmWorkerMessageType.WASMRuntimeInitialized) {
-          resolve();
-        }
-
-        if (type === WasmWorkerMessageType.LoadWASM && errMsg) {
-          reject(errMsg);
-        }
-      });
-    });
+      if (!instance) {
+        instance = createWasmWorker(options);
+        sharedWasmWorkers.set(this.sharedWorkerKey, instance);
+      }
+      this.wasmWorkerInstance = instance;
+    } else {
+      this.wasmWorkerInstance = createWasmWorker(options);
+    }
 
-    this.msgId = 0;
+    this.memoryBudget = options?.memoryBudget ?? 0;
+    this.packetRingSize = budgetSize(options?.packetRingSize ?? 0, this.memoryBudget);
+    this.priority = options?.priority;
+    this.wasmWorkerInstance.refCount++;
+    this.cancelSlot = this.wasmWorkerInstance.cancelSlotCounter++ % MAX_CANCEL_SLOTS;
+    this.wasmWorker = this.wasmWorkerInstance.worker;
+    this.wasmWorkerLoadStatus = this.wasmWorkerInstance.loadStatus;
   }
 
   private post(
     type: WasmWorkerMessageType,
     data?: WasmWorkerMessageData,
     msgId?: number,
+    transfer: Transferable[] = [],
   ) {
     this.wasmWorker.postMessage({
       type,
-      msgId: msgId ?? this.msgId++,
-      data,
-    });
+      msgId: msgId ?? nextMsgId(),
+      data: data && this.priority ? { ...data, priority: this.priority } : data,
+    }, transfer);
   }
 
-  private getFromWorker<T>(type: WasmWorkerMessageType, msgData: WasmWorkerMessageData): Promise<T> {
+  private getFromWorker<T>(
+    type: WasmWorkerMessageType,
+    msgData: WasmWorkerMessageData | undefined,
+    requireSource = true,
+    msgId = nextMsgId(),
+    transfer: Transferable[] = [],
+  ): Promise<T> {
     return new Promise((resolve, reject) => {
-      if (!this.source) {
+      if (requireSource && !this.source) {
         reject("source is not loaded. call load() first");
         return;
       }
 
-      const msgId = this.msgId;
       const msgListener = ({ data }: MessageEvent) => {
         if (data.type === type && data.msgId === msgId) {
           if (data.errMsg) {
@@ -103,10 +330,80 @@ export class WebDemuxer {
       };
 
       this.wasmWorker.addEventListener("message", msgListener);
-      this.post(type, msgData, msgId);
+      this.post(type, msgData, msgId, transfer);
     });
   }
 
+  private readFromWorker(
+    type: WasmWorkerMessageType,
+    msgData: ReadAVPacketMessageData | StartPlaybackMessageData | ReadKeyframePacketMessageData | ReadSegmentPacketMessageData,
+    requireSource = true,
+    msgId = nextMsgId(),
+  ): ReadableStream<WebAVPacket> {
+    // the worker reads ahead by the same bounded byte size
+    if (msgData.readAhead?.unit === "bytes" && msgData.readAhead.highWaterMark !== undefined) {
+      msgData = {
+        ...msgData,
+        readAhead: { ...msgData.readAhead, highWaterMark: budgetSize(msgData.readAhead.highWaterMark, this.memoryBudget) },
+      };
+    }
+
+    const { highWaterMark = 1, unit = "packets" } = msgData.readAhead ?? {};
+    const ring = this.packetRingSize > 0 && isPacketRingSupported()
+      ? new PacketRingReader(createPacketRing(this.packetRingSize))
+      : undefined;
+    // packets too large for the ring are posted, in ring order
+    const outOfBandPackets: WebAVPacket[] = [];
+    let outOfBandWaiter: (() => void) | undefined;
+
+    const nextOutOfBandPacket = async () => {
+      while (!outOfBandPackets.length) {
+        await new Promise<void>((resolve) => (outOfBandWaiter = resolve));
+      }
+      return outOfBandPackets.shift()!;
+    };
+
+    const pullFromRing = async (ring: PacketRingReader, controller: ReadableStreamDefaultController<WebAVPacket>) => {
+      while (controller.desiredSize! > 0 && !ring.stopped) {
+        // check closed before reading, packets are written before the ring is closed
+        const closed = ring.closed;
+        const packet = ring.read();
+
+        if (packet === OUT_OF_BAND_PACKET) {
+          controller.enqueue(await nextOutOfBandPacket());
+        } else if (packet) {
+          controller.enqueue(packet);
+        } else if (closed) {
+          controller.close();
+          return;
+        } else {
+          await ring.waitReadable();
+        }
+      }
+    };
+
+    return this.streamFromWorker(
+      type,
+      WasmWorkerMessageType.AVPacketStream,
+      msgData,
+      highWaterMark,
+      READ_AHEAD_SIZE[unit],
+      {
+        msgId,
+        requireSource,
+        ring: ring && {
+          buffer: ring.buffer,
+          receive: (packet) => {
+            outOfBandPackets.push(packet);
+            outOfBandWaiter?.();
+          },
+          pull: (controller) => pullFromRing(ring, controller),
+          stop: () => ring.stop(),
+        },
+      },
+    );
+  }
+
   /**
    * Load a file for demuxing
    * @param source source to load
@@ -115,16 +412,174 @@ export class WebDemuxer {
   public async load(source: File | string) {
     await this.wasmWorkerLoadStatus;
 
+    const prevSessionId = this.sessionId;
+
     this.source = source;
+
+    try {
+      this.sessionId = await this.getFromWorker<number>(WasmWorkerMessageType.OpenSource, { source });
+    } catch (e) {
+      this.source = undefined;
+      this.sessionId = undefined;
+      throw e;
+    } finally {
+      // requests still running on the previous source keep it open until they finish
+      if (prevSessionId !== undefined) {
+        this.post(WasmWorkerMessageType.CloseSource, { sessionId: prevSessionId });
+      }
+    }
+  }
+
+  /**
+   * Compile a wasm file ahead of time, later instances using the same
+   * wasmFilePath will only instantiate the shared compiled module
+   * @param wasmFilePath wasm file path
+   */
+  public static compileWASM(wasmFilePath: string): Promise<WebAssembly.Module> {
+    return getCompiledWASMModule(wasmFilePath).entry.module;
+  }
+
+  /**
+   * Probe the media info of many sources across a pool of workers.
+   * Sources are probed in batches mounted at once, results are returned as they complete.
+   * @param sources files or urls
+   * @param options pool options
+   * @returns ReadableStream<WebProbeResult>, in completion order
+   */
+  public static probeMany(sources: (File | string)[], options?: ProbeManyOptions): ReadableStream<WebProbeResult> {
+    const batchSize = Math.max(1, options?.batchSize ?? 16);
+    const concurrency = Math.max(1, Math.min(
+      options?.concurrency ?? Math.min(4, navigator.hardwareConcurrency || 1),
+      Math.ceil(sources.length / batchSize),
+    ));
+    const demuxers: WebDemuxer[] = [];
+    let nextIndex = 0;
+    let cancelled = false;
+
+    const runWorker = async (
+      demuxer: WebDemuxer,
+      controller: ReadableStreamDefaultController<WebProbeResult>,
+    ) => {
+      await demuxer.wasmWorkerLoadStatus;
+
+      while (!cancelled && nextIndex < sources.length) {
+        const first = nextIndex;
+        const batch = sources.slice(first, first + batchSize);
+        const msgId = nextMsgId();
+        const msgListener = ({ data }: MessageEvent) => {
+          if (data.type === WasmWorkerMessageType.ProbeResult && data.msgId === msgId && !cancelled) {
+            const index = first + data.result.index;
+
+            controller.enqueue({ ...data.result, index, source: sources[index] });
+          }
+        };
+
+        nextIndex += batch.length;
+        demuxer.wasmWorker.addEventListener("message", msgListener);
+
+        try {
+          await demuxer.getFromWorker(WasmWorkerMessageType.ProbeMany, { sources: batch }, false, msgId);
+        } finally {
+          demuxer.wasmWorker.removeEventListener("message", msgListener);
+        }
+      }
+    };
+
+    return new ReadableStream({
+      start: (controller) => {
+        if (!sources.length) {
+          controller.close();
+          return;
+        }
+
+        for (let i = 0; i < concurrency; i++) {
+          demuxers.push(new WebDemuxer({ wasmFilePath: options?.wasmFilePath }));
+        }
+
+        Promise.all(demuxers.map((demuxer) => runWorker(demuxer, controller)))
+          .then(() => {
+            if (!cancelled) {
+              controller.close();
+            }
+          }, (e) => {
+            if (!cancelled) {
+              controller.error(e);
+            }
+          })
+          .finally(() => {
+            demuxers.forEach((demuxer) => demuxer.destroy());
+          });
+      },
+      cancel: () => {
+        cancelled = true;
+      },
+    });
+  }
+
+  /**
+   * Get wasm startup timing of this instance
+   * @returns WASMStartupTiming
+   */
+  public async getStartupTiming(): Promise<WASMStartupTiming> {
+    await this.wasmWorkerLoadStatus;
+
+    return this.wasmWorkerInstance.startupTiming!;
+  }
+
+  /**
+   * Get queue wait times per request priority of the worker of this instance,
+   * shared by every instance on the same worker
+   * @returns WebSchedulerStats
+   */
+  public async getSchedulerStats(): Promise<WebSchedulerStats> {
+    await this.wasmWorkerLoadStatus;
+
+    return this.getFromWorker(WasmWorkerMessageType.GetSchedulerStats, undefined, false);
+  }
+
+  /**
+   * Get the wasm heap usage of the worker of this instance,
+   * shared by every instance on the same worker
+   * @returns WebMemoryStats
+   */
+  public async getMemoryStats(): Promise<WebMemoryStats> {
+    await this.wasmWorkerLoadStatus;
+
+    return this.getFromWorker(WasmWorkerMessageType.GetMemoryStats, undefined, false);
+  }
+
+  /**
+   * Recycle the wasm module instance of the worker to give its heap back, which never shrinks,
+   * e.g. between large files. The loaded source stays open and this instance keeps working,
+   * the I/O stats of the source start over. Fails while requests are running on the worker.
+   * @param minFragmentation recycle only when the heap fragmentation is at least this share, default 0
+   * @returns whether the module instance was recycled
+   */
+  public async recycle(minFragmentation = 0): Promise<boolean> {
+    await this.wasmWorkerLoadStatus;
+
+    return this.getFromWorker(WasmWorkerMessageType.RecycleWASM, { minFragmentation }, false);
   }
 
   /**
    * Destroy the demuxer instance
-   * terminate the worker
+   * close the source, terminate the worker if no other instance shares it
    */
   public destroy() {
+    if (this.sessionId !== undefined) {
+      this.post(WasmWorkerMessageType.CloseSource, { sessionId: this.sessionId });
+    }
+
     this.source = undefined;
-    this.wasmWorker.terminate();
+    this.sessionId = undefined;
+
+    if (--this.wasmWorkerInstance.refCount === 0) {
+      this.wasmWorker.terminate();
+
+      if (this.sharedWorkerKey !== undefined) {
+        sharedWasmWorkers.delete(this.sharedWorkerKey);
+      }
+    }
   }
 
   // ================ Base API ================
@@ -135,7 +590,7 @@ export class WebDemuxer {
    */
   public getMediaInfo(): Promise<WebMediaInfo> {
     return this.getFromWorker(WasmWorkerMessageType.GetMediaInfo, {
-      source: this.source!,
+      source: this.sessionId!,
     });
   }
 
@@ -150,7 +605,7 @@ export class WebDemuxer {
     streamIndex = -1,
   ): Promise<WebAVStream> {
     return this.getFromWorker(WasmWorkerMessageType.GetAVStream, {
-      source: this.source!,
+      source: this.sessionId!,
       streamType,
       streamIndex,
     });
@@ -162,7 +617,7 @@ export class WebDemuxer {
    */
   public getAVStreams(): Promise<WebAVStream[]> {
     return this.getFromWorker(WasmWorkerMessageType.GetAVStreams, {
-      source: this.source!,
+      source: this.sessionId!,
     });
   }
 
@@ -181,7 +636,7 @@ export class WebDemuxer {
     seekFlag = AVSeekFlag.AVSEEK_FLAG_BACKWARD
   ): Promise<WebAVPacket> {
     return this.getFromWorker(WasmWorkerMessageType.GetAVPacket, {
-      source: this.source!,
+      source: this.sessionId!,
       time,
       streamType,
       streamIndex,
@@ -200,19 +655,172 @@ export class WebDemuxer {
     seekFlag = AVSeekFlag.AVSEEK_FLAG_BACKWARD
   ): Promise<WebAVPacket[]> {
     return this.getFromWorker(WasmWorkerMessageType.GetAVPackets, {
-      source: this.source!,
+      source: this.sessionId!,
       time,
       seekFlag
     });
   }
 
+  /**
+   * Get the sample table of a MP4/MOV stream, in decode order
+   * @param streamType The type of media stream
+   * @param streamIndex The index of the media stream
+   * @returns WebSampleTable
+   */
+  public getSampleTable(
+    streamType = AVMediaType.AVMEDIA_TYPE_VIDEO,
+    streamIndex = -1
+  ): Promise<WebSampleTable> {
+    return this.getFromWorker(WasmWorkerMessageType.GetSampleTable, {
+      source: this.sessionId!,
+      streamType,
+      streamIndex
+    });
+  }
+
+  /**
+   * Get a run of samples of a MP4/MOV stream by their index in the sample table
+   * @param streamIndex The stream_index of the sample table
+   * @param first index of the first sample
+   * @param count number of samples, clamped to the end of the table
+   * @returns WebAVPacket[]
+   */
+  public getSamples(streamIndex: number, first: number, count = 1): Promise<WebAVPacket[]> {
+    return this.getFromWorker(WasmWorkerMessageType.GetSamples, {
+      source: this.sessionId!,
+      streamIndex,
+      first,
+      count
+    });
+  }
+
+  /**
+   * Gets the data at a specified time point, latest call wins.
+   * A newer call rejects the pending one with an `AbortError` and aborts the one
+   * in flight, so only the most recent position is demuxed while scrubbing.
+   * In-flight requests are aborted immediately when cross-origin isolated.
+   * @param time time in seconds
+   * @param streamType The type of media stream
+   * @param streamIndex The index of the media stream
+   * @param seekFlag The seek flag
+   * @returns WebAVPacket
+   */
+  public scrubAVPacket(
+    time: number,
+    streamType = AVMediaType.AVMEDIA_TYPE_VIDEO,
+    streamIndex = -1,
+    seekFlag = AVSeekFlag.AVSEEK_FLAG_BACKWARD
+  ): Promise<WebAVPacket> {
+    return new Promise((resolve, reject) => {
+      const superseded = new DOMException("superseded by a newer request", "AbortError");
+
+      this.scrubPending?.reject(superseded);
+      this.scrubPending = {
+        data: { time, streamType, streamIndex, seekFlag, cancelSlot: this.cancelSlot },
+        resolve,
+        reject,
+      };
+
+      if (this.scrubInFlight) {
+        // the next request is sent once the worker gives up the one in flight
+        this.cancelScrubInFlight(superseded);
+      } else {
+        this.runScrub();
+      }
+    });
+  }
+
+  private cancelScrubInFlight(reason: unknown) {
+    const inFlight = this.scrubInFlight;
+    const { cancelSignals } = this.wasmWorkerInstance;
+
+    if (!inFlight || inFlight.cancelled) return;
+
+    inFlight.cancelled = true;
+    inFlight.reject(reason);
+
+    if (cancelSignals) {
+      Atomics.store(cancelSignals, this.cancelSlot, -1);
+    }
+    this.post(WasmWorkerMessageType.CancelRequest, undefined, inFlight.msgId);
+  }
+
+  private runScrub() {
+    const request = this.scrubPending;
+
+    if (!request) return;
+
+    const msgId = nextMsgId();
+    const { cancelSignals } = this.wasmWorkerInstance;
+
+    this.scrubPending = undefined;
+    this.scrubInFlight = { msgId, reject: request.reject };
+
+    if (cancelSignals) {
+      Atomics.store(cancelSignals, this.cancelSlot, msgId);
+    }
+
+    this.getFromWorker<WebAVPacket>(WasmWorkerMessageType.GetAVPacket, {
+      source: this.sessionId!,
+      ...request.data,
+    }, true, msgId)
+      .then(request.resolve, request.reject)
+      .finally(() => {
+        this.scrubInFlight = undefined;
+        this.runScrub();
+      });
+  }
+
+  /**
+   * Analyze a stream in one pass inside wasm: GOP structure, keyframe intervals,
+   * bitrate series and timestamp anomalies, without sending packets to js
+   * @param start start time in seconds
+   * @param end end time in seconds, 0 means till end
+   * @param streamType The type of media stream
+   * @param streamIndex The index of the media stream
+   * @param bitrateBucket bucket duration of the bitrate series in seconds
+   * @returns WebStreamAnalysis
+   */
+  public analyzeAVStream(
+    start = 0,
+    end = 0,
+    streamType = AVMediaType.AVMEDIA_TYPE_VIDEO,
+    streamIndex = -1,
+    bitrateBucket = 1
+  ): Promise<WebStreamAnalysis> {
+    return this.getFromWorker(WasmWorkerMessageType.AnalyzeStream, {
+      source: this.sessionId!,
+      start,
+      end,
+      streamType,
+      streamIndex,
+      bitrateBucket
+    });
+  }
+
+  /**
+   * Read the whole source once in the background to record the keyframe positions of
+   * formats without a seek index of their own (FLV without keyframe metadata, MPEG-TS/PS),
+   * so later seeks into the source are a single positioned read.
+   * Seek points are also recorded by every other read, and kept until the source is closed.
+   * @returns number of seek points, 0 when the format has a seek index already
+   */
+  public buildSeekIndex(): Promise<number> {
+    return this.getFromWorker(WasmWorkerMessageType.BuildSeekIndex, {
+      source: this.sessionId!,
+    });
+  }
+
   /**
    * Returns a `ReadableStream` for streaming packet data.
+   * Long reads of a worker run one at a time: while this stream waits for its consumer,
+   * other streams of the worker wait, and fail after 5 s without progress.
    * @param start start time in seconds
    * @param end end time in seconds
    * @param streamType The type of media stream
    * @param streamIndex The index of the media stream
    * @param seekFlag The seek flag
+   * @param readAhead how far the worker may demux ahead of the consumer, default 1 packet
    * @returns ReadableStream<WebAVPacket>
    */
   public readAVPacket(
@@ -220,86 +828,319 @@ export class WebDemuxer {
     end = 0,
     streamType = AVMediaType.AVMEDIA_TYPE_VIDEO,
     streamIndex = -1,
-    seekFlag = AVSeekFlag.AVSEEK_FLAG_BACKWARD
+    seekFlag = AVSeekFlag.AVSEEK_FLAG_BACKWARD,
+    readAhead?: ReadAheadStrategy,
   ): ReadableStream<WebAVPacket> {
-    const queueingStrategy = new CountQueuingStrategy({ highWaterMark: 1 });
-    const msgId = this.msgId;
-    let pullCounter = 0;
+    return this.readFromWorker(WasmWorkerMessageType.ReadAVPacket, {
+      source: this.sessionId!,
+      start,
+      end,
+      streamType,
+      streamIndex,
+      seekFlag,
+      readAhead,
+    });
+  }
+
+  /**
+   * Start playback from a single open of the source: the selected video/audio streams
+   * and the first keyframe at start in one round trip, then the packets following it,
+   * demuxed on from the same position without opening the source again.
+   * @param start start time in seconds
+   * @param options streams to read, end time and read-ahead of the packet stream
+   * @returns WebAVPlayback
+   */
+  public startAVPlayback(start = 0, options?: PlaybackOptions): Promise<WebAVPlayback> {
+    const msgId = nextMsgId();
+    const toStreamIndex = (selection: boolean | number = true) =>
+      selection === true ? -1 : selection === false ? PLAYBACK_NO_STREAM : selection;
+
+    return new Promise((resolve, reject) => {
+      if (!this.source) {
+        reject("source is not loaded. call load() first");
+        return;
+      }
+
+      const msgListener = ({ data }: MessageEvent) => {
+        if (data.msgId !== msgId) return;
+
+        if (data.type === WasmWorkerMessageType.PlaybackStart) {
+          this.wasmWorker.removeEventListener("message", msgListener);
+          resolve({ ...data.result, packets });
+        } else if (data.type === WasmWorkerMessageType.StartPlayback && data.errMsg) {
+          this.wasmWorker.removeEventListener("message", msgListener);
+          reject(data.errMsg);
+        }
+      };
+
+      this.wasmWorker.addEventListener("message", msgListener);
+
+      const packets = this.readFromWorker(WasmWorkerMessageType.StartPlayback, {
+        source: this.sessionId!,
+        start,
+        end: options?.end ?? 0,
+        videoStreamIndex: toStreamIndex(options?.video),
+        audioStreamIndex: toStreamIndex(options?.audio),
+        readAhead: options?.readAhead,
+      }, true, msgId);
+    });
+  }
+
+  /**
+   * Returns a `ReadableStream` of keyframe packets only, for trick play and thumbnails.
+   * With a seek index (e.g. MP4/MOV, Matroska cues) delta frames are never read.
+   * @param start start time in seconds
+   * @param end end time in seconds
+   * @param streamType The type of media stream
+   * @param streamIndex The index of the media stream
+   * @param stride which keyframes to keep, default all
+   * @param readAhead how far the worker may demux ahead of the consumer, default 1 packet
+   * @returns ReadableStream<WebAVPacket>
+   */
+  public readKeyframeAVPacket(
+    start = 0,
+    end = 0,
+    streamType = AVMediaType.AVMEDIA_TYPE_VIDEO,
+    streamIndex = -1,
+    stride?: KeyframeStride,
+    readAhead?: ReadAheadStrategy,
+  ): ReadableStream<WebAVPacket> {
+    return this.readFromWorker(WasmWorkerMessageType.ReadKeyframePacket, {
+      source: this.sessionId!,
+      start,
+      end,
+      streamType,
+      streamIndex,
+      stride,
+      readAhead,
+    });
+  }
+
+  /**
+   * Export a clip of the loaded source into a new container by stream copy, without decoding.
+   * Only the bytes of the clip range and the headers are read.
+   * @param format output format, 'mp4' (fragmented), 'webm', 'matroska' or 'mov'
+   * @param start start time in seconds, moved back to the keyframe at or before it
+   * @param end end time in seconds, 0 exports to the end
+   * @param streamIndices streams to export, default is the best video and audio stream
+   * @param highWaterMark bytes buffered ahead of the consumer, default 4MB, bounded by the memory budget
+   * @returns ReadableStream of output chunks, e.g. piped to a file by pipeTo
+   */
+  public exportClip(
+    format = "mp4",
+    start = 0,
+    end = 0,
+    streamIndices: number[] = [],
+    highWaterMark = 4 * 1024 * 1024,
+  ): ReadableStream<Uint8Array> {
+    highWaterMark = budgetSize(highWaterMark, this.memoryBudget);
+
+    return this.streamFromWorker(
+      WasmWorkerMessageType.ExportClip,
+      WasmWorkerMessageType.ExportChunk,
+      {
+        source: this.sessionId!,
+        format,
+        start,
+        end,
+        streamIndices,
+        highWaterMark,
+      },
+      highWaterMark,
+      (chunk: Uint8Array) => chunk.byteLength,
+    );
+  }
+
+  /**
+   * Returns a `ReadableStream` of the GOPs of a stream walking backwards, for reverse playback.
+   * Each GOP is one batch of packets in decode order starting at its keyframe, decode it and
+   * present the frames reversed. Each GOP is read with one seek, and each byte once.
+   * @param start time to read backwards from in seconds, 0 from the end
+   * @param end time to stop at in seconds, the GOP containing it is the last one
+   * @param streamType The type of media stream
+   * @param streamIndex The index of the media stream
+   * @param highWaterMark GOPs demuxed ahead of the consumer, default 2
+   * @returns ReadableStream<WebAVPacket[]>
+   */
+  public readReverseAVPacket(
+    start = 0,
+    end = 0,
+    streamType = AVMediaType.AVMEDIA_TYPE_VIDEO,
+    streamIndex = -1,
+    highWaterMark = 2,
+  ): ReadableStream<WebAVPacket[]> {
+    return this.streamFromWorker(
+      WasmWorkerMessageType.ReadReverseGOP,
+      WasmWorkerMessageType.GOPStream,
+      {
+        source: this.sessionId!,
+        start,
+        end,
+        streamType,
+        streamIndex,
+        highWaterMark,
+      },
+      highWaterMark,
+      () => 1,
+    );
+  }
+
+  /**
+   * A stream of the items posted by the worker as itemType messages until null. The
+   * consumed size is reported to the worker by ReadNextAVPacket messages as the consumer
+   * reads, and cancelling stops the worker by StopReadAVPacket.
+   */
+  private streamFromWorker<T>(
+    type: WasmWorkerMessageType,
+    itemType: WasmWorkerMessageType,
+    msgData: WasmWorkerMessageData,
+    highWaterMark: number,
+    size: (item: T) => number,
+    { msgId = nextMsgId(), requireSource = true, ring }: WorkerStreamOptions<T> = {},
+  ): ReadableStream<T> {
+    // total size enqueued, and total consumed size last reported to the worker
+    let enqueuedSize = 0;
+    let reportedSize = 0;
     let msgListener: (e: MessageEvent) => void;
-    let cancelResolver: () => void;
+    let cancelResolver: (() => void) | undefined;
 
-    return new ReadableStream(
+    return new ReadableStream<T>(
       {
-        start: (controller) => {
-          if (!this.source) {
+        start: async (controller) => {
+          if (requireSource && !this.source) {
             controller.error("source is not loaded. call load() first");
             return;
           }
-          msgListener = (e: MessageEvent) => {
-            const data = e.data;
-
-            if (
-              data.type === WasmWorkerMessageType.ReadAVPacket &&
-              data.msgId === msgId
-            ) {
-              if (data.errMsg) {
-                controller.error(data.errMsg);
-                this.wasmWorker.removeEventListener("message", msgListener);
-              } else {
-                // noop
-              }
-            }
+          await this.wasmWorkerLoadStatus;
+          msgListener = ({ data }: MessageEvent) => {
+            if (data.msgId !== msgId) return;
 
-            if (
-              data.type === WasmWorkerMessageType.AVPacketStream &&
-              data.msgId === msgId
-            ) {
-              if (data.result && !cancelResolver) {
-                controller.enqueue(data.result);
-              } else {
+            if (data.type === type && data.errMsg) {
+              ring?.stop();
+              cancelResolver?.();
+              controller.error(data.errMsg);
+              this.wasmWorker.removeEventListener("message", msgListener);
+            } else if (data.type === itemType) {
+              if (data.result === null) {
                 this.wasmWorker.removeEventListener("message", msgListener);
                 // only close if the stream has not been cancelled from outside
                 if (cancelResolver) {
                   cancelResolver();
-                } else {
+                } else if (!ring) {
+                  // with a ring, the stream closes once the ring is drained
                   controller.close();
                 }
+              } else if (ring) {
+                ring.receive(data.result);
+              } else if (!cancelResolver) {
+                enqueuedSize += size(data.result);
+                controller.enqueue(data.result);
               }
             }
           };
 
           this.wasmWorker.addEventListener("message", msgListener);
-          this.post(WasmWorkerMessageType.ReadAVPacket, {
-            source: this.source,
-            start,
-            end,
-            streamType,
-            streamIndex,
-            seekFlag
-          });
+          this.post(type, ring ? { ...msgData, packetRing: ring.buffer } as WasmWorkerMessageData : msgData, msgId);
         },
-        pull: () => {
-          // first pull called by read don't send read next message
-          if (pullCounter > 0) {
-            this.post(
-              WasmWorkerMessageType.ReadNextAVPacket,
-              undefined,
-              msgId,
-            );
+        pull: (controller) => {
+          if (ring) {
+            return ring.pull(controller);
+          }
+
+          // whatever has been enqueued but is no longer queued was read by the consumer
+          const consumed = enqueuedSize - (highWaterMark - controller.desiredSize!);
+
+          if (consumed > reportedSize) {
+            reportedSize = consumed;
+            this.post(WasmWorkerMessageType.ReadNextAVPacket, { consumed }, msgId);
           }
-          pullCounter++;
         },
         cancel: () => {
           return new Promise((resolve) => {
             cancelResolver = resolve;
+            ring?.stop();
             this.post(WasmWorkerMessageType.StopReadAVPacket, undefined, msgId);
           });
         },
       },
-      queueingStrategy,
+      { highWaterMark, size },
     );
   }
 
+  // ================ Segment API ================
+
+  /**
+   * Returns a `ReadableStream` of packets demuxed from segments fed by `appendSegment`.
+   * One demux context is kept for the whole stream, so consecutive segments
+   * (e.g. HLS MPEG-TS) are not re-opened or re-probed.
+   * Packets of all streams are returned, use `stream_index` to route them.
+   * Long reads of a worker run one at a time: while this stream waits for segment data or
+   * its consumer, other streams of the worker wait, and fail after 5 s without progress.
+   * @param format input format name, skips probing
+   * @param readAhead how far the worker may demux ahead of the consumer, default 1 packet
+   * @returns ReadableStream<WebAVPacket>
+   */
+  public readSegmentPacket(format = "mpegts", readAhead?: ReadAheadStrategy): ReadableStream<WebAVPacket> {
+    const msgId = nextMsgId();
+
+    this.segmentStreamId = msgId;
+    this.segmentStreams = new Promise((resolve, reject) => {
+      const msgListener = ({ data }: MessageEvent) => {
+        if (data.msgId !== msgId) return;
+
+        if (data.type === WasmWorkerMessageType.SegmentAVStreams) {
+          resolve(data.result);
+        } else if (data.type === WasmWorkerMessageType.ReadSegmentPacket && data.errMsg) {
+          reject(data.errMsg);
+        } else if (data.type !== WasmWorkerMessageType.ReadSegmentPacket) {
+          return;
+        }
+        this.wasmWorker.removeEventListener("message", msgListener);
+      };
+
+      this.wasmWorker.addEventListener("message", msgListener);
+    });
+
+    return this.readFromWorker(WasmWorkerMessageType.ReadSegmentPacket, { format, readAhead }, false, msgId);
+  }
+
+  /**
+   * Get the streams of the current segment stream, resolved once the first segment is probed
+   * @returns WebAVStream[]
+   */
+  public getSegmentStreams(): Promise<WebAVStream[]> {
+    if (!this.segmentStreams) {
+      return Promise.reject("segment stream is not started. call readSegmentPacket() first");
+    }
+
+    return this.segmentStreams;
+  }
+
+  /**
+   * Append the next segment to the current segment stream.
+   * An `ArrayBuffer`, or a `Uint8Array` covering its whole buffer, is transferred to the
+   * worker instead of copied and is detached afterwards, pass a copy to keep using it.
+   * @param segment segment data
+   * @param last whether this is the last segment, ends the stream once demuxed
+   */
+  public async appendSegment(segment: ArrayBuffer | Uint8Array | null, last = false): Promise<void> {
+    if (this.segmentStreamId === undefined) {
+      throw "segment stream is not started. call readSegmentPacket() first";
+    }
+
+    await this.wasmWorkerLoadStatus;
+
+    const buffer = segment instanceof Uint8Array && segment.byteOffset === 0 && segment.byteLength === segment.buffer.byteLength
+      ? segment.buffer
+      : segment;
+
+    return this.getFromWorker(WasmWorkerMessageType.AppendSegment, {
+      streamId: this.segmentStreamId,
+      segment,
+      last,
+    }, false, undefined, buffer instanceof ArrayBuffer ? [buffer] : []);
+  }
+
   /**
    * Set log level
    * @param level log level
@@ -308,6 +1149,29 @@ export class WebDemuxer {
     return this.getFromWorker(WasmWorkerMessageType.SetAVLogLevel, { level })
   }
 
+  /**
+   * Get the bytes read from the loaded source so far
+   * @returns WebIOStats
+   */
+  public getIOStats(): Promise<WebIOStats> {
+    return this.getFromWorker(WasmWorkerMessageType.GetIOStats, { sessionId: this.sessionId! });
+  }
+
+  /**
+   * Start recording every read of the loaded source, replay it with scripts/replay-io-trace.js
+   */
+  public startIOTrace(): Promise<void> {
+    return this.getFromWorker(WasmWorkerMessageType.StartIOTrace, { sessionId: this.sessionId! });
+  }
+
+  /**
+   * Stop recording and get the trace, one "offset,length,latency_ms" line per read
+   * @returns trace text
+   */
+  public stopIOTrace(): Promise<string> {
+    return this.getFromWorker(WasmWorkerMessageType.StopIOTrace, { sessionId: this.sessionId! });
+  }
+
   // ================ Convenience API ================
 
   /**
@@ -320,6 +1184,27 @@ export class WebDemuxer {
     return this.getAVStream(MEDIA_TYPE_TO_AVMEDIA_TYPE[type], streamIndex);
   }
 
+  /**
+   * Analyze a media stream in one pass inside wasm
+   * @param type The type of media stream ('video', 'audio' or 'subtitle')
+   * @param start start time in seconds
+   * @param end end time in seconds
+   * @param bitrateBucket bucket duration of the bitrate series in seconds
+   * @returns WebStreamAnalysis
+   */
+  public analyzeMediaStream(type: MediaType, start?: number, end?: number, bitrateBucket?: number) {
+    return this.analyzeAVStream(start, end, MEDIA_TYPE_TO_AVMEDIA_TYPE[type], undefined, bitrateBucket);
+  }
+
+  /**
+   * Get the sample table of a MP4/MOV media stream
+   * @param type The type of media stream ('video', 'audio' or 'subtitle')
+   * @returns WebSampleTable
+   */
+  public getMediaSampleTable(type: MediaType) {
+    return this.getSampleTable(MEDIA_TYPE_TO_AVMEDIA_TYPE[type]);
+  }
+
   /**
    * Seek media packet at a time point
    * @param type The type of media ('video', 'audio' or 'subtitle')
@@ -331,21 +1216,72 @@ export class WebDemuxer {
     return this.getAVPacket(time, MEDIA_TYPE_TO_AVMEDIA_TYPE[type], undefined, seekFlag);
   }
 
+  /**
+   * Seek media packet at a time point, latest call wins
+   * @param type The type of media ('video', 'audio' or 'subtitle')
+   * @param time seek time in seconds
+   * @param seekFlag The seek flag
+   * @returns WebAVPacket
+   */
+  public scrubMediaPacket(type: MediaType, time: number, seekFlag?: AVSeekFlag) {
+    return this.scrubAVPacket(time, MEDIA_TYPE_TO_AVMEDIA_TYPE[type], undefined, seekFlag);
+  }
+
   /**
    * Read media packet as a stream
    * @param type The type of media ('video', 'audio' or 'subtitle')
    * @param start start time in seconds
    * @param end end time in seconds
    * @param seekFlag The seek flag
+   * @param readAhead how far the worker may demux ahead of the consumer
    * @returns ReadableStream<WebAVPacket>
    */
-  public readMediaPacket(type: MediaType, start?: number, end?: number, seekFlag?: AVSeekFlag) {
+  public readMediaPacket(type: MediaType, start?: number, end?: number, seekFlag?: AVSeekFlag, readAhead?: ReadAheadStrategy) {
     return this.readAVPacket(
       start,
       end,
       MEDIA_TYPE_TO_AVMEDIA_TYPE[type],
       undefined,
       seekFlag,
+      readAhead,
+    );
+  }
+
+  /**
+   * Read keyframe packets only as a stream
+   * @param type The type of media ('video', 'audio' or 'subtitle')
+   * @param start start time in seconds
+   * @param end end time in seconds
+   * @param stride which keyframes to keep, e.g. { every: 8 } or { minInterval: 2 }
+   * @param readAhead how far the worker may demux ahead of the consumer
+   * @returns ReadableStream<WebAVPacket>
+   */
+  public readKeyframeMediaPacket(type: MediaType, start?: number, end?: number, stride?: KeyframeStride, readAhead?: ReadAheadStrategy) {
+    return this.readKeyframeAVPacket(
+      start,
+      end,
+      MEDIA_TYPE_TO_AVMEDIA_TYPE[type],
+      undefined,
+      stride,
+      readAhead,
+    );
+  }
+
+  /**
+   * Read the GOPs of a stream backwards, see readReverseAVPacket
+   * @param type The type of media ('video', 'audio' or 'subtitle')
+   * @param start time to read backwards from in seconds, 0 from the end
+   * @param end time to stop at in seconds
+   * @param highWaterMark GOPs demuxed ahead of the consumer
+   * @returns ReadableStream<WebAVPacket[]>
+   */
+  public readReverseMediaPacket(type: MediaType, start?: number, end?: number, highWaterMark?: number) {
+    return this.readReverseAVPacket(
+      start,
+      end,
+      MEDIA_TYPE_TO_AVMEDIA_TYPE[type],
+      undefined,
+      highWaterMark,
     );
   }
 
@@ -425,21 +1361,94 @@ export class WebDemuxer {
     return this.seekMediaPacket(type, time, seekFlag).then(packet => this.genEncodedChunk(type, packet));
   }
 
+  /**
+   * Seek and return encoded chunk for WebCodecs, latest call wins
+   * @param type The type of media ('video' or 'audio')
+   * @param time time in seconds
+   * @param seekFlag The seek flag
+   * @returns EncodedVideoChunk | EncodedAudioChunk
+   */
+  public scrub<T extends WebCodecsSupportedMediaType>(
+    type: T,
+    time: number,
+    seekFlag?: AVSeekFlag
+  ): Promise<MediaTypeToChunk[T]> {
+    return this.scrubMediaPacket(type, time, seekFlag).then(packet => this.genEncodedChunk(type, packet));
+  }
+
   /**
    * Read encoded chunks as a stream for WebCodecs
    * @param type The type of media ('video' or 'audio')
    * @param start start time in seconds
    * @param end end time in seconds
    * @param seekFlag The seek flag
+   * @param readAhead how far the worker may demux ahead of the consumer
    * @returns ReadableStream<EncodedVideoChunk | EncodedAudioChunk>
    */
   public read<T extends WebCodecsSupportedMediaType>(
     type: T,
     start?: number,
     end?: number,
-    seekFlag?: AVSeekFlag
+    seekFlag?: AVSeekFlag,
+    readAhead?: ReadAheadStrategy,
+  ): ReadableStream<MediaTypeToChunk[T]> {
+    const avPackets = this.readMediaPacket(type, start, end, seekFlag, readAhead);
+    return avPackets.pipeThrough(
+      new TransformStream({
+        transform: (packet, controller) => {
+          const chunk = this.genEncodedChunk(type, packet);
+          controller.enqueue(chunk);
+        }
+      })
+    );
+  }
+
+  /**
+   * Start playback for WebCodecs from a single open of the source: decoder configs
+   * and the first keyframe chunk at start, then the chunks following it.
+   * Configure the decoders and decode `chunk` first for the shortest time to first frame.
+   * @param start start time in seconds
+   * @param options streams to read, end time and read-ahead of the chunk stream
+   * @returns WebCodecsPlayback
+   */
+  public async startPlayback(start?: number, options?: PlaybackOptions): Promise<WebCodecsPlayback> {
+    const { streams, packet, packets } = await this.startAVPlayback(start, options);
+    const videoStream = streams.find((stream) => stream.codec_type === AVMediaType.AVMEDIA_TYPE_VIDEO);
+    const audioStream = streams.find((stream) => stream.codec_type === AVMediaType.AVMEDIA_TYPE_AUDIO);
+    const typeOf = (packet: WebAVPacket) =>
+      packet.stream_index === videoStream?.index ? MediaTypes.VIDEO : MediaTypes.AUDIO;
+
+    return {
+      videoDecoderConfig: videoStream && this.genDecoderConfig(MediaTypes.VIDEO, videoStream),
+      audioDecoderConfig: audioStream && this.genDecoderConfig(MediaTypes.AUDIO, audioStream),
+      chunk: this.genEncodedChunk(typeOf(packet), packet),
+      chunks: packets.pipeThrough(
+        new TransformStream<WebAVPacket, EncodedVideoChunk | EncodedAudioChunk>({
+          transform: (packet, controller) => {
+            controller.enqueue(this.genEncodedChunk(typeOf(packet), packet));
+          }
+        })
+      ),
+    };
+  }
+
+  /**
+   * Read keyframes only as encoded chunks for WebCodecs, each one decodable on its own
+   * @param type The type of media ('video' or 'audio')
+   * @param start start time in seconds
+   * @param end end time in seconds
+   * @param stride which keyframes to keep, e.g. { every: 8 } or { minInterval: 2 }
+   * @param readAhead how far the worker may demux ahead of the consumer
+   * @returns ReadableStream<EncodedVideoChunk | EncodedAudioChunk>
+   */
+  public readKeyframes<T extends WebCodecsSupportedMediaType>(
+    type: T,
+    start?: number,
+    end?: number,
+    stride?: KeyframeStride,
+    readAhead?: ReadAheadStrategy,
   ): ReadableStream<MediaTypeToChunk[T]> {
-    const avPackets = this.readMediaPacket(type, start, end, seekFlag);
+    const avPackets = this.readKeyframeMediaPacket(type, start, end, stride, readAhead);
     return avPackets.pipeThrough(
       new TransformStream({
         transform: (packet, controller) => {
@@ -449,4 +1458,30 @@ export class WebDemuxer {
       })
     );
   }
+
+  /**
+   * Read GOPs backwards as batches of encoded chunks for WebCodecs, for reverse playback.
+   * Decode each batch in order and present its frames reversed.
+   * @param type The type of media ('video' or 'audio')
+   * @param start time to read backwards from in seconds, 0 from the end
+   * @param end time to stop at in seconds
+   * @param highWaterMark GOPs demuxed ahead of the consumer
+   * @returns ReadableStream<EncodedVideoChunk[] | EncodedAudioChunk[]>
+   */
+  public readReverse<T extends WebCodecsSupportedMediaType>(
+    type: T,
+    start?: number,
+    end?: number,
+    highWaterMark?: number,
+  ): ReadableStream<MediaTypeToChunk[T][]> {
+    const gops = this.readReverseMediaPacket(type, start, end, highWaterMark);
+    return gops.pipeThrough(
+      new TransformStream({
+        transform: (packets, controller) => {
+          controller.enqueue(packets.map((packet) => this.genEncodedChunk(type, packet)));
+        }
+      })
+    );
+  }
+
 }
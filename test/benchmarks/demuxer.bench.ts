@@ -0,0 +1,159 @@
+import { test, expect } from '@playwright/test';
+import path from 'path';
+import { fileURLToPath } from 'url';
+import fs from 'fs';
+import { generatedDir } from './global-setup';
+
+const __dirname = path.dirname(fileURLToPath(import.meta.url));
+
+interface BenchmarkResult {
+  /**
+   * ms from constructor to runtime initialized, wasm module not cached
+   */
+  initTime: number;
+  /**
+   * median ms of getMediaInfo
+   */
+  mediaInfoTime: number;
+  /**
+   * median ms of seekMediaPacket on the video stream
+   */
+  seekTime: number;
+  /**
+   * readMediaPacket of the whole video stream
+   */
+  packetsPerSecond: number;
+  megabytesPerSecond: number;
+  /**
+   * wasm heap of the worker after the run, in MB
+   */
+  heapPeak: number;
+}
+
+// whether a larger value is a regression, per metric
+const LOWER_IS_BETTER: Record<keyof BenchmarkResult, boolean> = {
+  initTime: true,
+  mediaInfoTime: true,
+  seekTime: true,
+  packetsPerSecond: false,
+  megabytesPerSecond: false,
+  heapPeak: true,
+};
+
+const pageUrl = 'http://localhost:5173';
+const inputFileSelector = '#example-get-media-info-file';
+const baselinesPath = path.join(__dirname, 'baselines.json');
+const resultsPath = process.env.BENCHMARK_OUTPUT || path.join(__dirname, '..', '..', 'test-results', 'benchmark.json');
+// relative change allowed against the baseline before a metric fails
+const tolerance = Number(process.env.BENCHMARK_TOLERANCE || 0.25);
+const updateBaselines = !!process.env.UPDATE_BENCHMARK_BASELINE;
+const iterations = 5;
+const seekPoints = 10;
+
+const getBenchmarkFiles = () => {
+  const dirs = [path.join(__dirname, '..', 'samples'), generatedDir];
+
+  return dirs
+    .filter((dir) => fs.existsSync(dir))
+    .flatMap((dir) => fs.readdirSync(dir, { withFileTypes: true })
+      .filter((entry) => entry.isFile() && !entry.name.endsWith('.tmp'))
+      .map((entry) => ({ path: path.join(dir, entry.name), name: entry.name })));
+};
+
+const baselines: Record<string, BenchmarkResult> = fs.existsSync(baselinesPath)
+  ? JSON.parse(fs.readFileSync(baselinesPath, 'utf-8'))
+  : {};
+const results: Record<string, BenchmarkResult> = {};
+
+test.afterAll(() => {
+  fs.mkdirSync(path.dirname(resultsPath), { recursive: true });
+  fs.writeFileSync(resultsPath, JSON.stringify(results, null, 2) + '\n');
+
+  if (updateBaselines) {
+    fs.writeFileSync(baselinesPath, JSON.stringify({ ...baselines, ...results }, null, 2) + '\n');
+  }
+});
+
+for (const { path: benchmarkFilePath, name } of getBenchmarkFiles()) {
+  test(`benchmark ${name}`, async ({ page }) => {
+    // a file without a baseline has nothing to be compared against until it is recorded
+    test.skip(!updateBaselines && !baselines[name], `no baseline for ${name}, record it with npm run benchmark:update`);
+
+    await page.goto(pageUrl);
+    await page.setInputFiles(inputFileSelector, benchmarkFilePath);
+
+    const result: BenchmarkResult = await page.evaluate(async ({ inputFileSelector, iterations, seekPoints }) => {
+      const WebDemuxer = window.demuxer.constructor as new (options: { wasmFilePath: string }) => typeof window.demuxer;
+      const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+      const median = (values: number[]) => values.slice().sort((a, b) => a - b)[Math.floor(values.length / 2)];
+
+      // a wasmFilePath of its own, so the module is compiled again rather than shared with window.demuxer
+      const demuxer = new WebDemuxer({ wasmFilePath: new URL('/src/lib/web-demuxer.wasm', location.href).href });
+      const { totalTime: initTime } = await demuxer.getStartupTiming();
+
+      await demuxer.load(file);
+
+      const mediaInfoTimes: number[] = [];
+      let duration = 0;
+
+      for (let i = 0; i < iterations; i++) {
+        const startTime = performance.now();
+
+        duration = (await demuxer.getMediaInfo()).duration;
+        mediaInfoTimes.push(performance.now() - startTime);
+      }
+
+      const seekTimes: number[] = [];
+
+      for (let i = 0; i < seekPoints; i++) {
+        const startTime = performance.now();
+
+        await demuxer.seekMediaPacket('video', duration * i / seekPoints);
+        seekTimes.push(performance.now() - startTime);
+      }
+
+      const reader = demuxer.readMediaPacket('video').getReader();
+      const readStartTime = performance.now();
+      let packetCount = 0;
+      let byteCount = 0;
+
+      while (true) {
+        const { done, value } = await reader.read();
+        if (done) break;
+        packetCount++;
+        byteCount += value.size;
+      }
+
+      const readTime = (performance.now() - readStartTime) / 1000;
+      const { heapSize } = await demuxer.getIOStats();
+
+      demuxer.destroy();
+
+      return {
+        initTime,
+        mediaInfoTime: median(mediaInfoTimes),
+        seekTime: median(seekTimes),
+        packetsPerSecond: packetCount / readTime,
+        megabytesPerSecond: byteCount / 1024 / 1024 / readTime,
+        heapPeak: heapSize / 1024 / 1024,
+      };
+    }, { inputFileSelector, iterations, seekPoints });
+
+    results[name] = result;
+    console.log(`${name}:`, JSON.stringify(result));
+
+    if (updateBaselines) return;
+
+    const baseline = baselines[name];
+
+    for (const metric of Object.keys(LOWER_IS_BETTER) as (keyof BenchmarkResult)[]) {
+      if (baseline[metric] === undefined) continue;
+
+      if (LOWER_IS_BETTER[metric]) {
+        expect.soft(result[metric], `${metric} of ${name}`).toBeLessThanOrEqual(baseline[metric] * (1 + tolerance));
+      } else {
+        expect.soft(result[metric], `${metric} of ${name}`).toBeGreaterThanOrEqual(baseline[metric] * (1 - tolerance));
+      }
+    }
+  });
+}
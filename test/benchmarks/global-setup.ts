@@ -0,0 +1,56 @@
+import { spawnSync } from 'child_process';
+import fs from 'fs';
+import path from 'path';
+import { fileURLToPath } from 'url';
+
+const __dirname = path.dirname(fileURLToPath(import.meta.url));
+
+export const generatedDir = path.join(__dirname, '.generated');
+
+// larger inputs than test/samples, generated once by the ffmpeg cli and kept out of git
+const generatedInputs: { name: string; args: string[] }[] = [
+  {
+    name: 'large_h264_aac_1080p_60s.mp4',
+    args: [
+      '-f', 'lavfi', '-i', 'testsrc2=size=1920x1080:rate=30:duration=60',
+      '-f', 'lavfi', '-i', 'sine=frequency=440:duration=60',
+      '-c:v', 'libx264', '-preset', 'ultrafast', '-g', '60', '-c:a', 'aac',
+    ],
+  },
+  {
+    name: 'long_h264_aac_360p_600s.mkv',
+    args: [
+      '-f', 'lavfi', '-i', 'testsrc2=size=640x360:rate=30:duration=600',
+      '-f', 'lavfi', '-i', 'sine=frequency=440:duration=600',
+      '-c:v', 'libx264', '-preset', 'ultrafast', '-g', '60', '-c:a', 'aac',
+    ],
+  },
+];
+
+export default function globalSetup() {
+  const ffmpeg = process.env.FFMPEG || 'ffmpeg';
+
+  if (spawnSync(ffmpeg, ['-version']).status !== 0) {
+    console.warn(`${ffmpeg} not found, benchmarking test/samples only`);
+    return;
+  }
+
+  fs.mkdirSync(generatedDir, { recursive: true });
+
+  for (const { name, args } of generatedInputs) {
+    const filePath = path.join(generatedDir, name);
+
+    if (fs.existsSync(filePath)) continue;
+
+    console.log(`generating ${name}`);
+
+    const format = path.extname(name) === '.mkv' ? 'matroska' : 'mp4';
+    const { status, stderr } = spawnSync(ffmpeg, ['-y', '-loglevel', 'error', ...args, '-f', format, filePath + '.tmp']);
+
+    if (status !== 0) {
+      throw new Error(`generating ${name} failed: ${stderr}`);
+    }
+
+    fs.renameSync(filePath + '.tmp', filePath);
+  }
+}
@@ -3,5 +3,6 @@ import { WebDemuxer } from '../src';
 declare global {
   interface Window {
     demuxer: WebDemuxer;
+    readAll<T>(stream: ReadableStream<T>): Promise<T[]>;
   }
 }
@@ -2,6 +2,7 @@ import { test, expect } from '@playwright/test';
 import path from 'path';
 import { fileURLToPath } from 'url';
 import fs from 'fs';
+import http from 'http';
 
 const __dirname = path.dirname(fileURLToPath(import.meta.url));
 interface TestFile {
@@ -12,12 +13,32 @@ interface TestFile {
 const pageUrl = 'http://localhost:5173';
 const inputFileSelector = '#example-get-media-info-file';
 
+// reads a stream to its end, installed on the page as window.readAll
+const installReadAll = () => {
+  window.readAll = async <T>(stream: ReadableStream<T>) => {
+    const values: T[] = [];
+    const reader = stream.getReader();
+
+    while (true) {
+      const { done, value } = await reader.read();
+      if (done) return values;
+      values.push(value);
+    }
+  };
+};
+
+test.beforeEach(async ({ page }) => {
+  await page.addInitScript(installReadAll);
+});
+
 const getTestFiles = (): TestFile[] => {
   const samplesDir = path.join(__dirname, '..', 'samples');
-  return fs.readdirSync(samplesDir)
-    .map(file => ({
-      path: path.join(samplesDir, file),
-      name: file
+  // samples/streams holds the inputs of single tests, without a media info fixture
+  return fs.readdirSync(samplesDir, { withFileTypes: true })
+    .filter(entry => entry.isFile())
+    .map(entry => ({
+      path: path.join(samplesDir, entry.name),
+      name: entry.name
     }));
 };
 
@@ -97,4 +118,942 @@ for (const {path: testFilePath, name} of getTestFiles()) {
     expect(audioPacket.data.buffer.byteLength).toBeGreaterThan(0);
     expect(audioPacket.timestamp).toBeGreaterThan(0);
   });
-}
\ No newline at end of file
+}
+
+test('should share the compiled wasm module across instances', async ({ page }) => {
+  await page.goto(pageUrl);
+
+  const timings = await page.evaluate(async () => {
+    const WebDemuxer = window.demuxer.constructor as new (options?: { wasmFilePath: string }) => typeof window.demuxer;
+    // a query no other instance of the page used, so the first one compiles
+    const wasmFilePath = new URL('/src/lib/web-demuxer.wasm?shared', location.href).href;
+    const cold = new WebDemuxer({ wasmFilePath });
+    const coldTiming = await cold.getStartupTiming();
+    const warm = new WebDemuxer({ wasmFilePath });
+    const warmTiming = await warm.getStartupTiming();
+    // the page demuxer compiled the default wasm file already
+    const defaultDemuxer = new WebDemuxer();
+    const defaultTiming = await defaultDemuxer.getStartupTiming();
+    const pageTiming = await window.demuxer.getStartupTiming();
+
+    cold.destroy();
+    warm.destroy();
+    defaultDemuxer.destroy();
+
+    return { cold: coldTiming, warm: warmTiming, default: defaultTiming, page: pageTiming };
+  });
+
+  console.log('wasm startup timing:', JSON.stringify(timings));
+
+  expect(timings.cold.cached).toBe(false);
+  expect(timings.cold.compileTime).toBeGreaterThan(0);
+  expect(timings.warm.cached).toBe(true);
+  expect(timings.warm.compileTime).toBe(0);
+  expect(timings.page.cached).toBe(false);
+  expect(timings.page.compileTime).toBeGreaterThan(0);
+  expect(timings.default.cached).toBe(true);
+  expect(timings.default.compileTime).toBe(0);
+});
+
+test('should interleave requests across sources on a shared worker', async ({ page }) => {
+  await page.goto(pageUrl);
+
+  const names = getTestFiles().map(({ name }) => name);
+  const formatNames = await page.evaluate(async (names) => {
+    const WebDemuxer = window.demuxer.constructor as new (options: { shareWorker: boolean }) => typeof window.demuxer;
+    const demuxers = names.map(() => new WebDemuxer({ shareWorker: true }));
+
+    await Promise.all(demuxers.map((demuxer, i) => demuxer.load(`${location.origin}/test/samples/${names[i]}`)));
+
+    const mediaInfos = await Promise.all(demuxers.map((demuxer) => demuxer.getMediaInfo()));
+
+    demuxers.forEach((demuxer) => demuxer.destroy());
+
+    return mediaInfos.map((mediaInfo) => mediaInfo.format_name);
+  }, names);
+
+  for (const [i, name] of names.entries()) {
+    const mediaInfoJsonPath = path.join(__dirname, '..', 'fixtures', 'mediainfo', name.replace(/\.[^.]+$/, '.json'));
+    const expectedInfo = JSON.parse(fs.readFileSync(mediaInfoJsonPath, 'utf-8'));
+
+    expect(formatNames[i]).toBe(expectedInfo.format_name);
+  }
+});
+
+test('should only resolve the latest scrub request', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const results = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    await window.demuxer.load(file);
+
+    const requests = Array.from({ length: 10 }, (_, i) => window.demuxer.scrubMediaPacket('video', i * 0.5));
+
+    return Promise.all(requests.map((request) => request.then(
+      (packet) => ({ status: 'resolved', timestamp: packet.timestamp }),
+      (e) => ({ status: e.name }),
+    )));
+  }, inputFileSelector);
+
+  expect(results.slice(0, -1).every(({ status }) => status === 'AbortError')).toBe(true);
+  expect(results[results.length - 1].status).toBe('resolved');
+});
+
+test('should read the same packets with a read-ahead queue', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const [defaultTimestamps, readAheadTimestamps] = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    await window.demuxer.load(file);
+
+    const packets = await Promise.all([
+      window.readAll(window.demuxer.readMediaPacket('video')),
+      window.readAll(window.demuxer.readMediaPacket('video', 0, 0, undefined, { highWaterMark: 2, unit: 'seconds' })),
+    ]);
+
+    return packets.map((list) => list.map(({ timestamp }) => timestamp));
+  }, inputFileSelector);
+
+  expect(defaultTimestamps.length).toBeGreaterThan(0);
+  expect(readAheadTimestamps).toEqual(defaultTimestamps);
+});
+
+test('should read the same packets with a shared packet ring', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const [defaultPackets, ringPackets] = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    // a small ring, so large packets take the out-of-band path, falls back to messages when not cross-origin isolated
+    const WebDemuxer = window.demuxer.constructor as new (options: { packetRingSize: number }) => typeof window.demuxer;
+    const ringDemuxer = new WebDemuxer({ packetRingSize: 4096 });
+
+    await Promise.all([window.demuxer.load(file), ringDemuxer.load(file)]);
+
+    const readPackets = async (stream: ReadableStream<{ timestamp: number; size: number; data: Uint8Array }>) =>
+      (await window.readAll(stream)).map(({ timestamp, size, data }) => [timestamp, size, data.reduce((sum, byte) => (sum + byte) % 65521, 0)]);
+
+    const result = await Promise.all([
+      readPackets(window.demuxer.readMediaPacket('audio')),
+      readPackets(ringDemuxer.readMediaPacket('audio', 0, 0, undefined, { highWaterMark: 8 })),
+    ]);
+
+    ringDemuxer.destroy();
+
+    return result;
+  }, inputFileSelector);
+
+  expect(defaultPackets.length).toBeGreaterThan(0);
+  expect(ringPackets).toEqual(defaultPackets);
+});
+
+test('should get samples by index from the mp4 sample table', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const result = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    await window.demuxer.load(file);
+
+    const table = await window.demuxer.getMediaSampleTable('video');
+    const first = Math.floor(table.sizes.length / 2);
+    const samples = await window.demuxer.getSamples(table.stream_index, first, 3);
+
+    return {
+      count: table.sizes.length,
+      firstIsKeyframe: table.keyframes[0],
+      sizes: Array.from(table.sizes.subarray(first, first + 3)),
+      keyframes: Array.from(table.keyframes.subarray(first, first + 3)),
+      sampleSizes: samples.map((sample) => sample.size),
+      sampleKeyframes: samples.map((sample) => sample.keyframe),
+    };
+  }, inputFileSelector);
+
+  expect(result.count).toBeGreaterThan(0);
+  expect(result.firstIsKeyframe).toBe(1);
+  expect(result.sampleSizes).toEqual(result.sizes);
+  expect(result.sampleKeyframes).toEqual(result.keyframes);
+});
+
+for (const {path: testFilePath, name} of getTestFiles()) {
+  test(`should report bytes read for a video-only read of ${name}`, async ({ page }) => {
+    await page.goto(pageUrl);
+    await page.setInputFiles(inputFileSelector, testFilePath);
+
+    const stats = await page.evaluate(async (inputFileSelector) => {
+      const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+      await window.demuxer.load(file);
+
+      const before = await window.demuxer.getIOStats();
+      const reader = window.demuxer.readMediaPacket('video').getReader();
+
+      while (!(await reader.read()).done) {
+        // drain
+      }
+
+      const after = await window.demuxer.getIOStats();
+
+      return { fileSize: file.size, bytesRead: after.bytesRead - before.bytesRead };
+    }, inputFileSelector);
+
+    console.log(`${name}: read ${stats.bytesRead} of ${stats.fileSize} bytes for video only, saved ${((1 - stats.bytesRead / stats.fileSize) * 100).toFixed(1)}%`);
+
+    expect(stats.bytesRead).toBeGreaterThan(0);
+  });
+}
+
+test('should skip the audio of a video-only read', async ({ page }) => {
+  await page.goto(pageUrl);
+  // the audio of the samples above comes in runs below the gap read through anyway, here it
+  // is one block of a third of the file behind the video
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'streams', 'mp4_h264_aac_blocks.mp4'));
+
+  const stats = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    await window.demuxer.load(file);
+
+    const before = await window.demuxer.getIOStats();
+    const videoCount = (await window.readAll(window.demuxer.readMediaPacket('video'))).length;
+    const after = await window.demuxer.getIOStats();
+
+    return { fileSize: file.size, bytesRead: after.bytesRead - before.bytesRead, videoCount };
+  }, inputFileSelector);
+
+  expect(stats.videoCount).toBe(250);
+  expect(stats.bytesRead).toBeLessThan(stats.fileSize * 0.8);
+});
+
+test('should analyze a stream in one pass', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const { analysis, packetCount, keyframeCount } = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    await window.demuxer.load(file);
+
+    const analysis = await window.demuxer.analyzeMediaStream('video');
+    const reader = window.demuxer.readMediaPacket('video').getReader();
+    let packetCount = 0;
+    let keyframeCount = 0;
+
+    while (true) {
+      const { done, value } = await reader.read();
+      if (done) break;
+      packetCount++;
+      keyframeCount += value.keyframe;
+    }
+
+    return { analysis, packetCount, keyframeCount };
+  }, inputFileSelector);
+
+  expect(analysis.packet_count).toBe(packetCount);
+  expect(analysis.keyframe_count).toBe(keyframeCount);
+  expect(analysis.gop_histogram.reduce((sum, { count }) => sum + count, 0)).toBe(keyframeCount);
+  expect(analysis.gop_histogram.reduce((sum, { length, count }) => sum + length * count, 0)).toBe(packetCount);
+  expect(analysis.bitrate_series.length).toBeGreaterThan(0);
+  expect(analysis.non_monotonic_dts_count).toBe(0);
+});
+
+test('should record an io trace of the loaded source', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mkv_h264_vorbis.mkv'));
+
+  const { trace, fileSize } = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    await window.demuxer.load(file);
+    await window.demuxer.startIOTrace();
+    await window.demuxer.seekMediaPacket('video', 1);
+
+    return { trace: await window.demuxer.stopIOTrace(), fileSize: file.size };
+  }, inputFileSelector);
+
+  const [header, ...reads] = trace.trim().split('\n');
+
+  expect(header).toBe(`# web-demuxer io trace v1 size=${fileSize}`);
+  expect(reads.length).toBeGreaterThan(0);
+
+  for (const read of reads) {
+    const [offset, length, latency] = read.split(',').map(Number);
+
+    expect(offset).toBeGreaterThanOrEqual(0);
+    expect(length).toBeGreaterThan(0);
+    expect(latency).toBeGreaterThanOrEqual(0);
+  }
+});
+
+test('should probe many files across a worker pool', async ({ page }) => {
+  await page.goto(pageUrl);
+
+  const sampleNames = getTestFiles().map(({ name }) => name);
+  const { results, totalTime } = await page.evaluate(async (sampleNames) => {
+    const WebDemuxer = window.demuxer.constructor as typeof window.demuxer.constructor & {
+      probeMany(sources: File[]): ReadableStream<{ index: number; mediaInfo?: { format_name: string }; error?: string }>;
+    };
+    const samples = await Promise.all(sampleNames.map(async (name) => {
+      const response = await fetch(`/test/samples/${name}`);
+      return new File([await response.blob()], name);
+    }));
+    const files = Array.from({ length: 500 }, (_, i) => samples[i % samples.length]);
+    const startTime = performance.now();
+    const reader = WebDemuxer.probeMany(files).getReader();
+    const results: { index: number; format_name?: string; error?: string }[] = [];
+
+    while (true) {
+      const { done, value } = await reader.read();
+      if (done) break;
+      results.push({ index: value.index, format_name: value.mediaInfo?.format_name, error: value.error });
+    }
+
+    return { results, totalTime: performance.now() - startTime };
+  }, sampleNames);
+
+  console.log(`probed ${results.length} files in ${totalTime.toFixed(0)} ms`);
+
+  expect(results.length).toBe(500);
+  expect(new Set(results.map(({ index }) => index)).size).toBe(500);
+  expect(results.every(({ format_name, error }) => format_name && !error)).toBe(true);
+});
+
+test('should read the same packets from a url with parallel range requests', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const [filePackets, urlPackets] = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    // small blocks, so reads span blocks, falls back to blocking requests when not cross-origin isolated
+    const WebDemuxer = window.demuxer.constructor as new (options: { urlSource: { blockSize: number } }) => typeof window.demuxer;
+    const urlDemuxer = new WebDemuxer({ urlSource: { blockSize: 16 * 1024 } });
+
+    await Promise.all([window.demuxer.load(file), urlDemuxer.load(`${location.origin}/test/samples/mp4_h264_aac.mp4`)]);
+
+    const readPackets = async (stream: ReadableStream<{ timestamp: number; size: number; data: Uint8Array }>) =>
+      (await window.readAll(stream)).map(({ timestamp, size, data }) => [timestamp, size, data.reduce((sum, byte) => (sum + byte) % 65521, 0)]);
+
+    const result = await Promise.all([
+      readPackets(window.demuxer.readMediaPacket('video')),
+      readPackets(urlDemuxer.readMediaPacket('video')),
+    ]);
+
+    urlDemuxer.destroy();
+
+    return result;
+  }, inputFileSelector);
+
+  expect(filePackets.length).toBeGreaterThan(0);
+  expect(urlPackets).toEqual(filePackets);
+});
+
+test('should retry failed and slow range requests of a url', async ({ page }) => {
+  const sample = fs.readFileSync(path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+  let requestCount = 0;
+  let failedCount = 0;
+  // fails every 4th range request and delays every 7th one
+  const server = http.createServer((req, res) => {
+    res.setHeader('Access-Control-Allow-Origin', '*');
+    res.setHeader('Access-Control-Allow-Headers', 'Range');
+    res.setHeader('Access-Control-Expose-Headers', 'Content-Range, Content-Length');
+
+    if (req.method === 'OPTIONS') {
+      res.end();
+      return;
+    }
+
+    if (req.method === 'HEAD') {
+      res.writeHead(200, { 'Content-Length': sample.byteLength });
+      res.end();
+      return;
+    }
+
+    const [, start, end] = /bytes=(\d+)-(\d+)/.exec(req.headers.range ?? '')!.map(Number);
+    const last = Math.min(end, sample.byteLength - 1);
+    const request = ++requestCount;
+
+    if (request % 4 === 0) {
+      failedCount++;
+      res.writeHead(503);
+      res.end();
+      return;
+    }
+
+    setTimeout(() => {
+      res.writeHead(206, {
+        'Content-Range': `bytes ${start}-${last}/${sample.byteLength}`,
+        'Content-Length': last - start + 1,
+      });
+      res.end(sample.subarray(start, last + 1));
+    }, request % 7 === 0 ? 500 : 5);
+  });
+
+  await new Promise<void>((resolve) => server.listen(0, resolve));
+
+  const url = `http://localhost:${(server.address() as { port: number }).port}/mp4_h264_aac.mp4`;
+
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const result = await page.evaluate(async ({ inputFileSelector, url }) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    const WebDemuxer = window.demuxer.constructor as new (options: { urlSource: { retryDelay: number } }) => typeof window.demuxer;
+    const urlDemuxer = new WebDemuxer({ urlSource: { retryDelay: 10 } });
+
+    await Promise.all([window.demuxer.load(file), urlDemuxer.load(url)]);
+
+    const countPackets = async (stream: ReadableStream<unknown>) => (await window.readAll(stream)).length;
+    const [fileCount, urlCount] = await Promise.all([
+      countPackets(window.demuxer.readMediaPacket('video')),
+      countPackets(urlDemuxer.readMediaPacket('video')),
+    ]);
+    const { requests = [] } = await urlDemuxer.getIOStats();
+
+    urlDemuxer.destroy();
+
+    return {
+      fileCount,
+      urlCount,
+      retried: requests.filter(({ attempts }) => attempts > 1).length,
+      hedged: requests.filter(({ hedged }) => hedged).length,
+      maxDuration: Math.max(...requests.map(({ duration }) => duration)),
+    };
+  }, { inputFileSelector, url });
+
+  server.close();
+
+  console.log(`${requestCount} requests, ${failedCount} failed:`, JSON.stringify(result));
+
+  expect(failedCount).toBeGreaterThan(0);
+  expect(result.urlCount).toBe(result.fileCount);
+  expect(result.retried).toBeGreaterThan(0);
+});
+
+test('should export a clip into a new mp4 file', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const result = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    await window.demuxer.load(file);
+
+    const { duration } = await window.demuxer.getMediaInfo();
+    const chunks: Uint8Array[] = [];
+    const reader = window.demuxer.exportClip('mp4', 1, 3).getReader();
+
+    while (true) {
+      const { done, value } = await reader.read();
+      if (done) break;
+      chunks.push(value);
+    }
+
+    const clipDemuxer = new (window.demuxer.constructor as new () => typeof window.demuxer)();
+    await clipDemuxer.load(new File(chunks, 'clip.mp4'));
+
+    const clipInfo = await clipDemuxer.getMediaInfo();
+    clipDemuxer.destroy();
+
+    return {
+      duration,
+      clipDuration: clipInfo.duration,
+      streams: clipInfo.nb_streams,
+    };
+  }, inputFileSelector);
+
+  expect(result.streams).toBe(2);
+  expect(result.clipDuration).toBeGreaterThan(0);
+  expect(result.clipDuration).toBeLessThan(result.duration);
+});
+
+for (const name of ['mp4_h264_aac.mp4', 'mkv_h264_vorbis.mkv']) {
+  test(`should read only the keyframes of ${name}`, async ({ page }) => {
+    await page.goto(pageUrl);
+    await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', name));
+
+    const result = await page.evaluate(async (inputFileSelector) => {
+      const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+      await window.demuxer.load(file);
+
+      const [all, keyframes, everySecond] = await Promise.all([
+        window.readAll(window.demuxer.readMediaPacket('video')),
+        window.readAll(window.demuxer.readKeyframeMediaPacket('video')),
+        window.readAll(window.demuxer.readKeyframeMediaPacket('video', 0, 0, { every: 2 })),
+      ]);
+
+      return {
+        expected: all.filter(({ keyframe }) => keyframe).map(({ timestamp }) => timestamp),
+        keyframes: keyframes.map(({ timestamp }) => timestamp),
+        allKeyframes: keyframes.every(({ keyframe }) => keyframe),
+        everySecond: everySecond.map(({ timestamp }) => timestamp),
+      };
+    }, inputFileSelector);
+
+    expect(result.keyframes.length).toBeGreaterThan(0);
+    expect(result.allKeyframes).toBe(true);
+    expect(result.keyframes.every((timestamp) => result.expected.includes(timestamp))).toBe(true);
+    expect(result.everySecond).toEqual(result.keyframes.filter((_, i) => i % 2 === 0));
+  });
+}
+
+for (const name of ['mp4_h264_aac.mp4', 'mkv_h264_vorbis.mkv']) {
+  test(`should read the GOPs of ${name} backwards`, async ({ page }) => {
+    await page.goto(pageUrl);
+    await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', name));
+
+    const result = await page.evaluate(async (inputFileSelector) => {
+      const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+      await window.demuxer.load(file);
+
+      const forward: number[] = [];
+      const forwardReader = window.demuxer.readMediaPacket('video').getReader();
+
+      while (true) {
+        const { done, value } = await forwardReader.read();
+        if (done) break;
+        forward.push(value.timestamp);
+      }
+
+      const gops: { timestamp: number; keyframe: number }[][] = [];
+      const reverseReader = window.demuxer.readReverseMediaPacket('video').getReader();
+
+      while (true) {
+        const { done, value } = await reverseReader.read();
+        if (done) break;
+        gops.push(value.map(({ timestamp, keyframe }) => ({ timestamp, keyframe })));
+      }
+
+      return {
+        forward,
+        gopCount: gops.length,
+        startWithKeyframe: gops.every((gop) => gop[0].keyframe === 1),
+        // GOPs in forward order, packets in decode order
+        reversed: gops.reverse().flat().map(({ timestamp }) => timestamp),
+      };
+    }, inputFileSelector);
+
+    expect(result.gopCount).toBeGreaterThan(1);
+    expect(result.startWithKeyframe).toBe(true);
+    expect(result.reversed).toEqual(result.forward);
+  });
+}
+
+test('should fetch the moov at the end of a url in one request', async ({ page }) => {
+  const sample = fs.readFileSync(path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+  let mdatEnd = 0;
+
+  // the sample is not faststart: ftyp, free, mdat, moov
+  for (let position = 0; position < sample.length; position += sample.readUInt32BE(position)) {
+    if (sample.toString('latin1', position + 4, position + 8) === 'mdat') {
+      mdatEnd = position + sample.readUInt32BE(position);
+      break;
+    }
+  }
+
+  await page.goto(pageUrl);
+
+  const result = await page.evaluate(async (mdatEnd) => {
+    const WebDemuxer = window.demuxer.constructor as new (options: { urlSource: { blockSize: number; readAhead: number } }) => typeof window.demuxer;
+    const urlDemuxer = new WebDemuxer({ urlSource: { blockSize: 16 * 1024, readAhead: 0 } });
+
+    await urlDemuxer.load(`${location.origin}/test/samples/mp4_h264_aac.mp4`);
+
+    const { nb_streams } = await urlDemuxer.getMediaInfo();
+    const { requests = [] } = await urlDemuxer.getIOStats();
+
+    urlDemuxer.destroy();
+
+    return {
+      nb_streams,
+      tailRequests: requests.filter(({ start }) => start === mdatEnd).map(({ length }) => length),
+      moovBlockRequests: requests.filter(({ start, length }) => start > mdatEnd && length > 0).length,
+    };
+  }, mdatEnd);
+
+  expect(result.nb_streams).toBe(2);
+  expect(result.tailRequests).toEqual([sample.length - mdatEnd]);
+  expect(result.moovBlockRequests).toBe(0);
+});
+
+test('should start playback from a single open', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const result = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    await window.demuxer.load(file);
+
+    const readTimestamps = async (stream: ReadableStream<{ stream_index: number; timestamp: number }>, streamIndex: number) =>
+      (await window.readAll(stream)).filter(({ stream_index }) => stream_index === streamIndex).map(({ timestamp }) => timestamp);
+
+    const { streams, packet, packets } = await window.demuxer.startAVPlayback(1);
+    const playbackTimestamps = await readTimestamps(packets, packet.stream_index);
+    const seekPacket = await window.demuxer.seekMediaPacket('video', 1);
+    const readTimestampsFromSeek = await readTimestamps(window.demuxer.readMediaPacket('video', 1), packet.stream_index);
+    const { chunk, videoDecoderConfig, audioDecoderConfig } = await window.demuxer.startPlayback(1, { audio: false });
+
+    return {
+      streamTypes: streams.map((stream) => stream.codec_type_string),
+      packet: { keyframe: packet.keyframe, timestamp: packet.timestamp, size: packet.size },
+      seekPacket: { keyframe: seekPacket.keyframe, timestamp: seekPacket.timestamp, size: seekPacket.size },
+      timestamps: [packet.timestamp, ...playbackTimestamps],
+      readTimestamps: readTimestampsFromSeek,
+      chunkType: chunk.type,
+      chunkIsVideo: chunk instanceof EncodedVideoChunk,
+      videoCodec: videoDecoderConfig?.codec,
+      hasAudioConfig: !!audioDecoderConfig,
+    };
+  }, inputFileSelector);
+
+  expect(result.streamTypes).toEqual(['video', 'audio']);
+  expect(result.packet).toEqual(result.seekPacket);
+  expect(result.packet.keyframe).toBe(1);
+  expect(result.timestamps).toEqual(result.readTimestamps);
+  expect(result.chunkType).toBe('key');
+  expect(result.chunkIsVideo).toBe(true);
+  expect(result.videoCodec).toBeTruthy();
+  expect(result.hasAudioConfig).toBe(false);
+});
+
+test('should fail a read held back by a stream nobody reads', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const result = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    await window.demuxer.load(file);
+
+    // the video read stays suspended, waiting for a consumer
+    const stalled = window.demuxer.readMediaPacket('video').getReader();
+    await stalled.read();
+
+    const error = await window.readAll(window.demuxer.readMediaPacket('audio')).then(() => '', (e) => String(e));
+    const seekPacket = await window.demuxer.seekMediaPacket('video', 1);
+
+    await stalled.cancel();
+
+    return { error, seekTimestamp: seekPacket.timestamp };
+  }, inputFileSelector);
+
+  expect(result.error).toContain('suspended waiting for its consumer');
+  expect(result.seekTimestamp).toBeGreaterThanOrEqual(0);
+});
+
+test('should schedule requests of a shared worker by priority', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const result = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    const WebDemuxer = window.demuxer.constructor as new (options: { shareWorker: boolean; priority?: string }) => typeof window.demuxer;
+    const player = new WebDemuxer({ shareWorker: true });
+    const exporter = new WebDemuxer({ shareWorker: true, priority: 'background' });
+
+    await Promise.all([player.load(file), exporter.load(file)]);
+
+    const countPackets = async (stream: ReadableStream<unknown>) => (await window.readAll(stream)).length;
+
+    // a read-ahead large enough to never wait for the consumer, so only slices give way
+    const [backgroundCount, seekPacket] = await Promise.all([
+      countPackets(exporter.readMediaPacket('video', 0, 0, undefined, { highWaterMark: 1e9 })),
+      player.seekMediaPacket('video', 1),
+    ]);
+    const playbackCount = await countPackets(player.readMediaPacket('video'));
+    const stats = await player.getSchedulerStats();
+
+    player.destroy();
+    exporter.destroy();
+
+    return { backgroundCount, playbackCount, seekTimestamp: seekPacket.timestamp, stats };
+  }, inputFileSelector);
+
+  console.log('scheduler stats:', JSON.stringify(result.stats));
+
+  expect(result.backgroundCount).toBe(result.playbackCount);
+  expect(result.seekTimestamp).toBeGreaterThan(0);
+  expect(result.stats.interactive.requests).toBeGreaterThanOrEqual(1);
+  expect(result.stats.playback.requests).toBeGreaterThanOrEqual(1);
+  expect(result.stats.background.requests).toBe(1);
+  expect(result.stats.background.queued).toBe(0);
+});
+
+test('should recycle the wasm module and keep the source open', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const result = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    const WebDemuxer = window.demuxer.constructor as new (options: { memoryBudget: number }) => typeof window.demuxer;
+    const demuxer = new WebDemuxer({ memoryBudget: 32 * 1024 * 1024 });
+
+    await demuxer.load(file);
+
+    const before = await demuxer.seekMediaPacket('video', 1);
+    const reader = demuxer.readMediaPacket('video').getReader();
+
+    while (!(await reader.read()).done) {
+      // grow the heap
+    }
+
+    const statsBefore = await demuxer.getMemoryStats();
+    const skipped = await demuxer.recycle(1.1);
+    const recycled = await demuxer.recycle();
+    const statsAfter = await demuxer.getMemoryStats();
+    const after = await demuxer.seekMediaPacket('video', 1);
+
+    demuxer.destroy();
+
+    return { before, after, statsBefore, statsAfter, skipped, recycled };
+  }, inputFileSelector);
+
+  console.log('memory stats before and after recycling:', JSON.stringify(result.statsBefore), JSON.stringify(result.statsAfter));
+
+  expect(result.skipped).toBe(false);
+  expect(result.recycled).toBe(true);
+  expect(result.statsBefore.memoryBudget).toBe(32 * 1024 * 1024);
+  expect(result.statsBefore.heapUsed).toBeGreaterThan(0);
+  expect(result.statsAfter.heapSize).toBeLessThanOrEqual(result.statsBefore.heapSize);
+  expect(result.after.timestamp).toBe(result.before.timestamp);
+  expect(result.after.size).toBe(result.before.size);
+});
+
+// the full build stands in for the mp4 build, which is not part of the default wasm build,
+// the query tells the two module requests apart
+for (const { name, module } of [
+  { name: 'mp4_h264_aac.mp4', module: 'mp4' },
+  { name: 'flv_h264_aac.flv', module: 'full' },
+]) {
+  test(`should load the ${module} module for the first source ${name} lazily`, async ({ page }) => {
+    const moduleRequests: string[] = [];
+
+    page.on('request', (request) => {
+      const url = new URL(request.url());
+      if (url.pathname === '/src/lib/web-demuxer.wasm' && url.searchParams.has('module')) {
+        moduleRequests.push(url.searchParams.get('module')!);
+      }
+    });
+
+    await page.goto(pageUrl);
+    await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', name));
+
+    const result = await page.evaluate(async (inputFileSelector) => {
+      const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+      const WebDemuxer = window.demuxer.constructor as new (options: { wasmFilePath: string; formatModules: { mp4: string } }) => typeof window.demuxer;
+      const moduleUrl = (module: string) => new URL(`/src/lib/web-demuxer.wasm?module=${module}`, location.href).href;
+      const demuxer = new WebDemuxer({ wasmFilePath: moduleUrl('full'), formatModules: { mp4: moduleUrl('mp4') } });
+      const before = await demuxer.getMemoryStats();
+
+      await demuxer.load(file);
+
+      const { nb_streams } = await demuxer.getMediaInfo();
+      const after = await demuxer.getMemoryStats();
+
+      demuxer.destroy();
+
+      return { heapBefore: before.heapSize, heapAfter: after.heapSize, nb_streams };
+    }, inputFileSelector);
+
+    expect(result.heapBefore).toBe(0);
+    expect(result.heapAfter).toBeGreaterThan(0);
+    expect(result.nb_streams).toBe(2);
+    expect(moduleRequests).toEqual([module]);
+  });
+}
+
+test('should switch to the full module while a read of another format is running', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const result = await page.evaluate(async (inputFileSelector) => {
+    const mp4File = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    const WebDemuxer = window.demuxer.constructor as new (options: { wasmFilePath: string; shareWorker: boolean; formatModules: { mp4: string } }) => typeof window.demuxer;
+    const moduleUrl = (module: string) => new URL(`/src/lib/web-demuxer.wasm?module=${module}`, location.href).href;
+    const options = { wasmFilePath: moduleUrl('full'), shareWorker: true, formatModules: { mp4: moduleUrl('mp4') } };
+    const mp4Demuxer = new WebDemuxer(options);
+    const webmDemuxer = new WebDemuxer(options);
+
+    await mp4Demuxer.load(mp4File);
+
+    const expected = (await window.readAll(mp4Demuxer.readMediaPacket('video'))).length;
+    const reader = mp4Demuxer.readMediaPacket('video').getReader();
+    let count = (await reader.read()).done ? 0 : 1;
+
+    // the mp4 read is running on the mp4 module while the webm source needs the full one
+    await webmDemuxer.load(`${location.origin}/test/samples/webm_vp8_vorbis.webm`);
+
+    const { format_name } = await webmDemuxer.getMediaInfo();
+
+    while (!(await reader.read()).done) {
+      count++;
+    }
+
+    const after = (await window.readAll(mp4Demuxer.readMediaPacket('video'))).length;
+
+    mp4Demuxer.destroy();
+    webmDemuxer.destroy();
+
+    return { expected, count, after, format_name };
+  }, inputFileSelector);
+
+  expect(result.format_name).toContain('webm');
+  expect(result.count).toBe(result.expected);
+  expect(result.after).toBe(result.expected);
+});
+
+const FORMAT_MODULE_BY_EXTENSION: Record<string, string> = { '.mp4': 'mp4', '.mkv': 'matroska', '.webm': 'matroska' };
+
+for (const { path: testFilePath, name } of getTestFiles().filter(({ name }) => path.extname(name) in FORMAT_MODULE_BY_EXTENSION)) {
+  const module = FORMAT_MODULE_BY_EXTENSION[path.extname(name)];
+
+  test(`should get the same media info for ${name} from the ${module} module`, async ({ page }) => {
+    test.skip(!fs.existsSync(path.join(__dirname, '..', '..', 'src', 'lib', `web-demuxer-${module}.wasm`)), 'per-format modules are built by npm run build:wasm:formats');
+
+    await page.goto(pageUrl);
+    await page.setInputFiles(inputFileSelector, testFilePath);
+
+    const [fullInfo, formatInfo] = await page.evaluate(async ({ inputFileSelector, module }) => {
+      const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+      const WebDemuxer = window.demuxer.constructor as new (options: { formatModules: Record<string, string> }) => typeof window.demuxer;
+      const formatDemuxer = new WebDemuxer({
+        formatModules: { [module]: new URL(`/src/lib/web-demuxer-${module}.wasm`, location.href).href },
+      });
+
+      await Promise.all([window.demuxer.load(file), formatDemuxer.load(file)]);
+
+      const result = await Promise.all([window.demuxer.getMediaInfo(), formatDemuxer.getMediaInfo()]);
+
+      formatDemuxer.destroy();
+
+      return result;
+    }, { inputFileSelector, module });
+
+    expect(formatInfo).toEqual(fullInfo);
+  });
+}
+
+test('should seek by a positioned read after building the seek index', async ({ page }) => {
+  await page.goto(pageUrl);
+  // MPEG-TS has no seek index of its own, keyframes every second
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'streams', 'ts_h264_aac.ts'));
+
+  const result = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    const demuxer = window.demuxer;
+
+    await demuxer.load(file);
+
+    const measure = async <T>(request: () => Promise<T>) => {
+      const before = await demuxer.getIOStats();
+      const value = await request();
+      const after = await demuxer.getIOStats();
+
+      return { value, bytesRead: after.bytesRead - before.bytesRead, readCount: after.readCount - before.readCount };
+    };
+
+    // every request opens and probes the source, only the reads beyond that are the seek
+    const open = await measure(() => demuxer.getMediaInfo());
+    const search = await measure(() => demuxer.seekMediaPacket('video', 6.5));
+    const count = await demuxer.buildSeekIndex();
+    const positioned = await measure(() => demuxer.seekMediaPacket('video', 8.5));
+
+    return {
+      count,
+      searchBytes: search.bytesRead - open.bytesRead,
+      searchReads: search.readCount - open.readCount,
+      positionedBytes: positioned.bytesRead - open.bytesRead,
+      positionedReads: positioned.readCount - open.readCount,
+      packet: positioned.value,
+    };
+  }, inputFileSelector);
+
+  console.log('seek reads before and after indexing:', JSON.stringify(result));
+
+  expect(result.count).toBeGreaterThan(0);
+  expect(result.packet.keyframe).toBe(1);
+  expect(result.packet.timestamp).toBeCloseTo(7.88, 2);
+  expect(result.positionedReads).toBeLessThan(result.searchReads);
+  expect(result.positionedBytes * 2).toBeLessThan(result.searchBytes);
+});
+
+test('should answer repeated seeks from the packet cache', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'mp4_h264_aac.mp4'));
+
+  const result = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+
+    await window.demuxer.load(file);
+
+    const first = await window.demuxer.seekMediaPacket('video', 1.5);
+    const { bytesRead } = await window.demuxer.getIOStats();
+    const second = await window.demuxer.seekMediaPacket('video', 1.5);
+    const between = await window.demuxer.seekMediaPacket('video', (first.timestamp + 1.5) / 2);
+    const stats = await window.demuxer.getIOStats();
+
+    return { first, second, between, bytesRead, stats };
+  }, inputFileSelector);
+
+  expect(result.second.timestamp).toBe(result.first.timestamp);
+  expect(result.second.size).toBe(result.first.size);
+  expect(result.between.timestamp).toBe(result.first.timestamp);
+  expect(result.stats.bytesRead).toBe(result.bytesRead);
+  expect(result.stats.packetCache.hits).toBe(2);
+  expect(result.stats.packetCache.misses).toBe(1);
+  expect(result.stats.packetCache.size).toBe(result.first.size);
+});
+
+test('should read continuous timestamps across appended segments', async ({ page }) => {
+  await page.goto(pageUrl);
+  await page.setInputFiles(inputFileSelector, path.join(__dirname, '..', 'samples', 'streams', 'ts_h264_aac.ts'));
+
+  const result = await page.evaluate(async (inputFileSelector) => {
+    const file = (document.querySelector(inputFileSelector) as HTMLInputElement).files![0];
+    const data = new Uint8Array(await file.arrayBuffer());
+    // split on MPEG-TS packet boundaries, like the segments of a HLS playlist
+    const segmentSize = Math.ceil(data.length / 188 / 4) * 188;
+    const segments = Array.from({ length: Math.ceil(data.length / segmentSize) }, (_, i) => data.slice(i * segmentSize, (i + 1) * segmentSize));
+    const WebDemuxer = window.demuxer.constructor as new () => typeof window.demuxer;
+    const segmentDemuxer = new WebDemuxer();
+
+    // only resolves when the last segment ends the stream
+    const packets = window.readAll(segmentDemuxer.readSegmentPacket('mpegts', { highWaterMark: 64 }));
+
+    for (let i = 0; i < segments.length; i++) {
+      await segmentDemuxer.appendSegment(segments[i], i === segments.length - 1);
+    }
+
+    const segmentPackets = await packets;
+    const streams = await segmentDemuxer.getSegmentStreams();
+
+    segmentDemuxer.destroy();
+    await window.demuxer.load(file);
+
+    const [video, audio] = await Promise.all([
+      window.readAll(window.demuxer.readMediaPacket('video')),
+      window.readAll(window.demuxer.readMediaPacket('audio')),
+    ]);
+    const packetsOf = (streamIndex: number) => segmentPackets.filter(({ stream_index }) => stream_index === streamIndex);
+
+    return {
+      segmentCount: segments.length,
+      streamTypes: streams.map((stream) => stream.codec_type_string),
+      video: packetsOf(0).map(({ timestamp }) => timestamp),
+      audio: packetsOf(1).map(({ timestamp, duration }) => [timestamp, duration]),
+      fileVideo: video.map(({ timestamp }) => timestamp),
+      fileAudio: audio.map(({ timestamp }) => timestamp),
+    };
+  }, inputFileSelector);
+
+  expect(result.segmentCount).toBe(4);
+  expect(result.streamTypes).toEqual(['video', 'audio']);
+  expect(result.video).toEqual(result.fileVideo);
+  expect(result.audio.map(([timestamp]) => timestamp)).toEqual(result.fileAudio);
+
+  // every packet starts where the previous one ended, segment boundaries included
+  for (let i = 1; i < result.audio.length; i++) {
+    const [prevTimestamp, prevDuration] = result.audio[i - 1];
+    expect(result.audio[i][0]).toBeCloseTo(prevTimestamp + prevDuration, 3);
+  }
+
+  const presentation = [...result.video].sort((a, b) => a - b);
+  for (let i = 1; i < presentation.length; i++) {
+    expect(presentation[i] - presentation[i - 1]).toBeCloseTo(0.04, 3);
+  }
+});